@@ -52,6 +52,7 @@ struct SwitchAnnotation
 struct SwitchCaseAnnotation
 {
     const Command* is_var_eq_int; // may be `nullptr` for SWITCH_START/CONTINUED instead.
+    const Command* is_var_gt_int; // may be `nullptr` if not optimizing nor available.
 };
 
 struct IncDecAnnotation
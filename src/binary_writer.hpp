@@ -3,27 +3,44 @@
 #include <memory>
 
 /// Interface to write little-endian bytes.
+///
+/// The writer may either own its buffer, which is then of a fixed size or grows as needed, or write into
+/// memory provided by the caller (e.g. a memory mapped output file).
+///
+/// Every `emplace_*` makes room for its bytes. To check only once for a sequence of bytes (e.g. a whole
+/// instruction), `reserve` the room for them and then emplace them with the unchecked `put_*` methods.
 struct BinaryWriter
 {
 public:
+    /// Constructs a writer whose buffer grows as bytes are emplaced into it.
     explicit BinaryWriter()
-        : offset(0), max_offset(0)
+        : bytes(nullptr), offset(0), capacity(0), growable(true)
     {}
 
+    /// Constructs a writer with a fixed size buffer of `size` bytes.
     explicit BinaryWriter(size_t size) :
-        offset(0), max_offset(size), bytecode(new uint8_t[size])
+        bytecode(new uint8_t[size]), offset(0), capacity(size), growable(false)
+    {
+        this->bytes = this->bytecode.get();
+    }
+
+    /// Constructs a writer into the `size` bytes at `data`, which must be alive as long as this object.
+    explicit BinaryWriter(void* data, size_t size) :
+        bytes(static_cast<uint8_t*>(data)), offset(0), capacity(size), growable(false)
     {}
 
     /// \returns the buffer with the generated bytes.
     const void* buffer() const
     {
-        return this->bytecode.get();
+        return this->bytes;
     }
 
     /// \returns the size of the buffer with the generated bytes.
+    ///
+    /// This is the number of emplaced bytes for growable writers, and the size of the buffer for the others.
     size_t buffer_size() const
     {
-        return this->max_offset;
+        return this->growable? this->offset : this->capacity;
     }
 
     size_t current_offset() const
@@ -31,26 +48,32 @@ public:
         return this->offset;
     }
 
+    /// Makes room for `count` more bytes at the current offset, to be emplaced by the `put_*` methods.
+    ///
+    /// Only growable writers may grow, for the others this is just a bounds check.
+    void reserve(size_t count)
+    {
+        const size_t end = this->offset + count;
+        if(end > this->capacity)
+            this->reallocate(std::max(end, this->capacity * 2));
+    }
+
     void emplace_u8(uint8_t value)
     {
-        assert(this->offset + 1 <= max_offset);
-        bytecode[this->offset++] = reinterpret_cast<uint8_t&>(value);
+        this->reserve(1);
+        this->put_u8(value);
     }
 
     void emplace_u16(uint16_t value)
     {
-        //assert(this->offset + 2 <= max_offset);
-        emplace_u8((value & 0x00FF) >> 0);
-        emplace_u8((value & 0xFF00) >> 8);
+        this->reserve(2);
+        this->put_u16(value);
     }
 
     void emplace_u32(uint32_t value)
     {
-        //assert(this->offset + 4 <= max_offset);
-        emplace_u8((value & 0x000000FF) >> 0);
-        emplace_u8((value & 0x0000FF00) >> 8);
-        emplace_u8((value & 0x00FF0000) >> 16);
-        emplace_u8((value & 0xFF000000) >> 24);
+        this->reserve(4);
+        this->put_u32(value);
     }
 
     void emplace_i8(int8_t value)
@@ -70,49 +93,143 @@ public:
 
     void emplace_bytes(size_t count, const void* bytes)
     {
-        assert(this->offset + count <= max_offset);
-        std::memcpy(&this->bytecode[offset], bytes, count);
-        this->offset += count;
+        this->reserve(count);
+        this->put_bytes(count, bytes);
     }
 
     void emplace_fill(size_t count, uint8_t val)
     {
-        assert(this->offset + count <= max_offset);
-        std::memset(&this->bytecode[offset], val, count);
+        this->reserve(count);
+        std::memset(&this->bytes[offset], val, count);
         this->offset += count;
     }
 
     void emplace_chars(size_t count, const char* data)
     {
-        assert(this->offset + count <= max_offset);
-        std::strncpy(reinterpret_cast<char*>(&this->bytecode[offset]), data, count);
-        this->offset += count;
+        this->reserve(count);
+        this->put_chars(count, data);
     }
 
     void emplace_chars(size_t count, const char* data, bool to_upper)
+    {
+        this->reserve(count);
+        this->put_chars(count, data, to_upper);
+    }
+
+    template<typename FuncT>
+    void emplace_chars(size_t count, const char* data, FuncT transform)
+    {
+        this->reserve(count);
+        this->put_chars(count, data, transform);
+    }
+
+    /// Same as `emplace_u8`, but the room must have been made by `reserve`.
+    void put_u8(uint8_t value)
+    {
+        assert(this->offset + 1 <= this->capacity);
+        this->bytes[this->offset++] = value;
+    }
+
+    /// Same as `emplace_u16`, but the room must have been made by `reserve`.
+    void put_u16(uint16_t value)
+    {
+        assert(this->offset + 2 <= this->capacity);
+        this->store_le(this->offset, value);
+        this->offset += 2;
+    }
+
+    /// Same as `emplace_u32`, but the room must have been made by `reserve`.
+    void put_u32(uint32_t value)
+    {
+        assert(this->offset + 4 <= this->capacity);
+        this->store_le(this->offset, value);
+        this->offset += 4;
+    }
+
+    void put_i8(int8_t value)
+    {
+        return put_u8(reinterpret_cast<uint8_t&>(value));
+    }
+
+    void put_i16(int16_t value)
+    {
+        return put_u16(reinterpret_cast<uint16_t&>(value));
+    }
+
+    void put_i32(int32_t value)
+    {
+        return put_u32(reinterpret_cast<uint32_t&>(value));
+    }
+
+    /// Same as `emplace_bytes`, but the room must have been made by `reserve`.
+    void put_bytes(size_t count, const void* bytes)
+    {
+        assert(this->offset + count <= this->capacity);
+        std::memcpy(&this->bytes[offset], bytes, count);
+        this->offset += count;
+    }
+
+    /// Same as `emplace_chars`, but the room must have been made by `reserve`.
+    void put_chars(size_t count, const char* data)
+    {
+        assert(this->offset + count <= this->capacity);
+        std::strncpy(reinterpret_cast<char*>(&this->bytes[offset]), data, count);
+        this->offset += count;
+    }
+
+    void put_chars(size_t count, const char* data, bool to_upper)
     {
         if(to_upper)
-            return emplace_chars(count, data, toupper_ascii);
+            return put_chars(count, data, toupper_ascii);
         else
-            return emplace_chars(count, data);
+            return put_chars(count, data);
     }
 
     template<typename FuncT>
-    void emplace_chars(size_t count, const char* data, FuncT transform)
+    void put_chars(size_t count, const char* data, FuncT transform)
     {
-        assert(this->offset + count <= max_offset);
-        for(size_t i = 0; i < count; ++i)
-        {
-            if(*data == 0)
-                this->bytecode[offset+i] = 0;
-            else
-                this->bytecode[offset+i] = transform(*data++);
-        }
+        assert(this->offset + count <= this->capacity);
+        auto output = &this->bytes[offset];
+        size_t length = std::find(data, data + count, '\0') - data;
+        for(size_t i = 0; i < length; ++i)
+            output[i] = transform(data[i]);
+        std::memset(output + length, 0, count - length);
         this->offset += count;
     }
 
+    /// Overwrites the four bytes at `at` with `value`, without changing the current offset.
+    void patch_i32(size_t at, int32_t value)
+    {
+        assert(at + 4 <= this->buffer_size());
+        this->store_le(at, reinterpret_cast<uint32_t&>(value));
+    }
+
+private:
+    /// Stores `value` in little-endian at `at`. Compilers turn this into a single store on little-endian machines.
+    template<typename T>
+    void store_le(size_t at, T value)
+    {
+        uint8_t le[sizeof(T)];
+        for(size_t i = 0; i < sizeof(T); ++i)
+            le[i] = static_cast<uint8_t>(value >> (8 * i));
+        std::memcpy(&this->bytes[at], le, sizeof(T));
+    }
+
+    void reallocate(size_t new_capacity)
+    {
+        assert(this->growable);
+        std::unique_ptr<uint8_t[]> new_bytecode(new uint8_t[new_capacity]);
+        if(this->offset)
+            std::memcpy(new_bytecode.get(), this->bytes, this->offset);
+        this->bytecode = std::move(new_bytecode);
+        this->bytes = this->bytecode.get();
+        this->capacity = new_capacity;
+    }
+
 private:
-    std::unique_ptr<uint8_t[]>  bytecode; // size == max_offset
+    std::unique_ptr<uint8_t[]>  bytecode;   // owned buffer, if any
+    uint8_t*                    bytes;      // size == capacity
     size_t                      offset;
-    size_t                      max_offset;
+    size_t                      capacity;
+    bool                        growable;
 };
@@ -10,49 +10,125 @@
 ///
 template<typename T, typename TCodeGen>
 void generate_code(const T&, TCodeGen&);
-void generate_code(const CompiledData& data, CodeGenerator& codegen);
 void generate_code(const CompiledScmHeader& data, CodeGeneratorData& codegen);
 
+/// Code generation options known at compile time, so that the emission of every argument does not need to check them.
 ///
-/// This function should be overloaded/specialized for each pseudo-object generated by *compiler.hpp/cpp*.
-/// By default it calls `T.compiled_size()`.
-///
-template<typename T, typename TCodeGen>
-size_t compiled_size(const T&, const TCodeGen&);
-size_t compiled_size(const ArgVariant&, const CodeGenerator&);
-size_t compiled_size(const CompiledData&, const CodeGenerator&);
+/// See `visit_profile` for choosing the profile of a `CodeGenerator`.
+template<bool OptimizeZeroFloats, bool HalfFloat, bool TextLabelPrefix, bool UsesOATC>
+struct EmitProfile
+{
+    static constexpr bool optimize_zero_floats  = OptimizeZeroFloats;   //< Same as `Options::optimize_zero_floats`.
+    static constexpr bool use_half_float        = HalfFloat;            //< Same as `Options::use_half_float`.
+    static constexpr bool has_text_label_prefix = TextLabelPrefix;      //< Same as `Options::has_text_label_prefix`.
+    static constexpr bool uses_oatc             = UsesOATC;             //< Whether `CodeGenerator::oatc` is set.
+};
+
+/// Calls `functor` with the `EmitProfile` matching the options of `codegen`.
+template<typename Functor>
+static void visit_profile(const CodeGenerator& codegen, Functor functor);
+
+template<typename T, typename Profile>
+void generate_code(const T&, CodeGenerator&, Profile);
 
-uint32_t CodeGenerator::compute_labels()
+/// Computes the size of an argument once generated with `Profile`.
+template<typename Profile>
+size_t compiled_size(const ArgVariant&, Profile);
+template<typename Profile>
+void generate_code(const CompiledData& data, CodeGenerator& codegen, Profile);
+
+/// Finds the size and the label references of `ccmd`, for `CodeGenerator::emit`.
+template<typename Profile>
+static size_t emit_command(const CompiledCommand& ccmd, CodeGenerator& codegen, Profile);
+
+/// Computes the value of the label reference `fixup` from the code of `codegen`.
+static int32_t label_reference(const CodeGenerator::LabelFixup& fixup, CodeGenerator& codegen);
+
+uint32_t CodeGenerator::emit()
 {
-    uint32_t offset = 0;
-    for(auto& op : this->compiled)
+    this->label_fixups.clear();
+    this->missing_opcode = nullptr;
+
+    size_t offset = 0;
+
+    visit_profile(*this, [&](auto profile)
     {
-        if(is<CompiledLabelDef>(op.data))
+        for(auto& op : this->compiled)
         {
-            get<CompiledLabelDef>(op.data).label->code_position = offset;
-        }
-        else
-        {
-            offset += compiled_size(op, *this);
+            if(is<CompiledLabelDef>(op.data))
+            {
+                auto& label = this->ir_arena.label(get<CompiledLabelDef>(op.data).label);
+                label.code_position = static_cast<uint32_t>(offset);
+            }
+            else if(is<CompiledCommand>(op.data))
+            {
+                offset += emit_command(get<CompiledCommand>(op.data), *this, profile);
+            }
+            else
+            {
+                offset += get<CompiledHex>(op.data).compiled_size();
+            }
         }
+    });
+
+    return static_cast<uint32_t>(offset);
+}
+
+void CodeGenerator::resolve_labels()
+{
+    this->label_issues.clear();
+
+    for(auto& fixup : this->label_fixups)
+    {
+        fixup.value = label_reference(fixup, *this);
     }
-    return offset;
 }
 
-void CodeGenerator::generate()
+void CodeGenerator::generate(void* output)
 {
-    this->bw = BinaryWriter(this->script->code_size.value());
+    this->bw = BinaryWriter(output, this->script->code_size.value());
+    this->next_fixup = 0;
+
+    visit_profile(*this, [this](auto profile)
+    {
+        for(auto& op : this->compiled)
+            generate_code(op, *this, profile);
+    });
+
+    assert(this->bw.current_offset() == this->bw.buffer_size());
+    assert(this->next_fixup == this->label_fixups.size());
+}
 
-    for(auto& op : this->compiled)
+void CodeGenerator::report_issues()
+{
+    if(this->missing_opcode)
     {
-        generate_code(op, *this);
+        program.fatal_error(this->missing_opcode->source(*this->script), "could not compile command {}, no id or no hash [-moatc]",
+                            this->missing_opcode->command.name);
+    }
+
+    for(auto& issue : this->label_issues)
+    {
+        auto context = issue.second->source(*this->script);
+        switch(issue.first)
+        {
+            case LabelIssue::ZeroOffset:
+                program.error(context, "compiled script references a label at the zero offset");
+                program.note(nocontext, "try using SCRIPT_NAME or NOP at the very top of your script");
+                break;
+            case LabelIssue::LocalOffsetIntoMain:
+                program.error(context, "cannot branch from this script into main block using local offsets [-mlocal-offsets]");
+                break;
+            default:
+                Unreachable();
+        }
     }
 }
 
-void CodeGeneratorData::generate()
+void CodeGeneratorData::generate(void* output)
 {
-    visit_one(this->compiled, [this](const auto& h) {
-        this->bw = BinaryWriter(h.compiled_size());
+    visit_one(this->compiled, [&](const auto& h) {
+        this->bw = BinaryWriter(output, h.compiled_size());
         generate_code(h, *this);
     });
 }
@@ -70,9 +146,10 @@ CustomHeaderOATC::CustomHeaderOATC(const std::vector<CodeGenerator*>& gens, Prog
                 auto& ccmd = get<CompiledCommand>(op.data);
                 if(ccmd.command.hash)
                 {
-                    if(!this->find_opcode(ccmd.command))
+                    auto ordinal = (uint16_t) this->ordinal_commands.size();
+                    if(this->ordinal_index.emplace(&ccmd.command, ordinal).second)
                     {
-                        this->ordinal_commands.emplace_back(&ccmd.command, (uint16_t) this->ordinal_commands.size());
+                        this->ordinal_commands.emplace_back(&ccmd.command, ordinal);
                     }
                 }
                 else if(ccmd.command.id && this->starting_opcode < *ccmd.command.id)
@@ -94,10 +171,8 @@ optional<uint16_t> CustomHeaderOATC::find_opcode(const Command& command) const
 {
     if(command.hash)
     {
-        auto it = std::find_if(ordinal_commands.begin(), ordinal_commands.end(), [&](const auto& pair) {
-            return pair.first == &command;
-        });
-        if(it != this->ordinal_commands.end())
+        auto it = this->ordinal_index.find(&command);
+        if(it != this->ordinal_index.end())
             return it->second + this->starting_opcode;
     }
     return nullopt;
@@ -112,64 +187,112 @@ size_t CompiledHeaderList::compiled_size() const
 
 ////////////////////////////////////////////////////////////////////////
 
-template<typename T>
-inline size_t compiled_size(const T& x, const CodeGenerator&)
+inline size_t CompiledScmHeader::compiled_size() const
 {
-    return x.compiled_size();
+    switch(this->version)
+    {
+        case CompiledScmHeader::Version::Liberty:
+        case CompiledScmHeader::Version::Miami:
+        {
+            auto size_globals = this->size_global_vars_space;
+            return 8 + (size_globals - 8) + 8 + 4 + (24 * (1 + this->models.size()))
+                + 8 + 4 + 4 + 2 + 2 + (4 * this->num_missions);
+            break;
+        }
+        case CompiledScmHeader::Version::SanAndreas:
+        {
+            auto size_globals = this->size_global_vars_space;
+            return 8 + (size_globals - 8) + 8 + 4 + (24 * (1 + this->models.size()))
+                + 8 + 4 + 4 + 2 + 2 + (4 * this->num_missions) + 4 //<SA
+                + 8 + 4 + 4 + (28 * (1 + this->num_streamed))
+                + 8 + 4 + 8 + 4 + 1 + 1 + 2;
+            break;
+        }
+        default:
+            Unreachable();
+    }
 }
 
-inline size_t compiled_size(const EOAL&, const CodeGenerator&)
+inline size_t CustomHeaderOATC::compiled_size() const
+{
+    size_t size = 12 + 4 + 2 + 2 + (12 * this->ordinal_commands.size());
+    for(auto& pair : ordinal_commands) size += pair.first->name.size() + 1;
+    return size;
+}
+
+size_t CodeGeneratorData::compiled_size() const
+{
+    return visit_one(this->compiled, [](const auto& h) { return h.compiled_size(); });
+}
+
+////////////////////////////////////////////////////////////////////////
+
+template<typename T, typename CodeGen>
+inline void generate_code(const T& x, CodeGen& codegen)
+{
+    return x.generate_code(codegen);
+}
+
+template<typename Profile>
+inline size_t compiled_size(const EOAL&, Profile)
 {
     return 1;
 }
 
-inline size_t compiled_size(const int8_t&, const CodeGenerator&)
+template<typename Profile>
+inline size_t compiled_size(const int8_t&, Profile)
 {
     return 1 + sizeof(int8_t);
 }
 
-inline size_t compiled_size(const int16_t&, const CodeGenerator&)
+template<typename Profile>
+inline size_t compiled_size(const int16_t&, Profile)
 {
     return 1 + sizeof(int16_t);
 }
 
-inline size_t compiled_size(const int32_t&, const CodeGenerator&)
+template<typename Profile>
+inline size_t compiled_size(const int32_t&, Profile)
 {
     return 1 + sizeof(int32_t);
 }
 
-inline size_t compiled_size(const float& f, const CodeGenerator& codegen)
+template<typename Profile>
+inline size_t compiled_size(const float& value, Profile)
 {
-    if(codegen.program.opt.optimize_zero_floats && f == 0.0f)
+    if(Profile::optimize_zero_floats && value == 0.0f)
         return 1 + sizeof(int8_t);
-    if(codegen.program.opt.use_half_float)
+    if(Profile::use_half_float)
         return 1 + sizeof(int16_t);
     return 1 + sizeof(float);
 }
 
-inline size_t compiled_size(const shared_ptr<Label>&, const CodeGenerator&)
+template<typename Profile>
+inline size_t compiled_size(const LabelRef&, Profile)
 {
     return 1 + sizeof(int32_t);
 }
 
-inline size_t compiled_size(const CompiledVar& v, const CodeGenerator&)
+template<typename Profile>
+inline size_t compiled_size(const CompiledVar& v, Profile)
 {
-    if(v.index == nullopt || is<int32_t>(*v.index))
+    if(v.index_type != CompiledVar::IndexType::Var)
         return 1 + sizeof(uint16_t);
     else
         return 1 + sizeof(uint16_t) * 2 + sizeof(uint8_t) * 2;
 }
 
-inline size_t compiled_size(const CompiledString& s, const CodeGenerator& codegen)
+template<typename Profile>
+inline size_t compiled_size(const CompiledString& str, Profile)
 {
-    switch(s.type)
+    switch(str.type)
     {
         case CompiledString::Type::TextLabel8:
-            return (codegen.program.opt.has_text_label_prefix? 1 : 0) + 8;
+            return (Profile::has_text_label_prefix? 1 : 0) + 8;
         case CompiledString::Type::TextLabel16:
             return 1 + 16;
         case CompiledString::Type::StringVar:
-            return 1 + 1 + s.storage.size();
+            return 1 + 1 + str.size;
         case CompiledString::Type::String128:
             return 128;
         default:
@@ -177,249 +300,210 @@ inline size_t compiled_size(const CompiledString& s, const CodeGenerator& codege
     }
 }
 
-inline size_t compiled_size(const ArgVariant& varg, const CodeGenerator& codegen)
+template<typename Profile>
+inline size_t compiled_size(const ArgVariant& varg, Profile profile)
 {
-    return visit_one(varg, [&](const auto& arg) { return ::compiled_size(arg, codegen); });
-}
-
-inline size_t compiled_size(const CompiledCommand& cmd, const CodeGenerator& codegen)
-{
-    size_t size = sizeof(uint16_t);
-    for(auto& a : cmd.args) size += ::compiled_size(a, codegen);
-    return size;
-}
-
-inline size_t CompiledScmHeader::compiled_size() const
-{
-    switch(this->version)
-    {
-        case CompiledScmHeader::Version::Liberty:
-        case CompiledScmHeader::Version::Miami:
-        {
-            auto size_globals = this->size_global_vars_space;
-            return 8 + (size_globals - 8) + 8 + 4 + (24 * (1 + this->models.size()))
-                + 8 + 4 + 4 + 2 + 2 + (4 * this->num_missions);
-            break;
-        }
-        case CompiledScmHeader::Version::SanAndreas:
-        {
-            auto size_globals = this->size_global_vars_space;
-            return 8 + (size_globals - 8) + 8 + 4 + (24 * (1 + this->models.size()))
-                + 8 + 4 + 4 + 2 + 2 + (4 * this->num_missions) + 4 //<SA
-                + 8 + 4 + 4 + (28 * (1 + this->num_streamed))
-                + 8 + 4 + 8 + 4 + 1 + 1 + 2;
-            break;
-        }
-        default:
-            Unreachable();
-    }
-}
-
-inline size_t CustomHeaderOATC::compiled_size() const
-{
-    size_t size = 12 + 4 + 2 + 2 + (12 * this->ordinal_commands.size());
-    for(auto& pair : ordinal_commands) size += pair.first->name.size() + 1;
-    return size;
-}
-
-inline size_t compiled_size(const CompiledData& data, const CodeGenerator& codegen)
-{
-    return visit_one(data.data, [&](const auto& data) { return ::compiled_size(data, codegen); });
-}
-
-////////////////////////////////////////////////////////////////////////
-
-template<typename T, typename CodeGen>
-inline void generate_code(const T& x, CodeGen& codegen)
-{
-    return x.generate_code(codegen);
+    return visit_one(varg, [&](const auto& arg) { return ::compiled_size(arg, profile); });
 }
 
 inline void generate_code(const EOAL&, CodeGenerator& codegen)
 {
-    codegen.bw.emplace_u8(0);
+    codegen.bw.put_u8(0);
 }
 
 inline void generate_code(const int8_t& value, CodeGenerator& codegen)
 {
-    codegen.bw.emplace_u8(4);
-    codegen.bw.emplace_i8(value);
+    codegen.bw.put_u8(4);
+    codegen.bw.put_i8(value);
 }
 
 inline void generate_code(const int16_t& value, CodeGenerator& codegen)
 {
-    codegen.bw.emplace_u8(5);
-    codegen.bw.emplace_i16(value);
+    codegen.bw.put_u8(5);
+    codegen.bw.put_i16(value);
 }
 
 inline void generate_code(const int32_t& value, CodeGenerator& codegen)
 {
-    codegen.bw.emplace_u8(1);
-    codegen.bw.emplace_i32(value);
+    codegen.bw.put_u8(1);
+    codegen.bw.put_i32(value);
 }
 
-inline void generate_code(const float& value, CodeGenerator& codegen)
+template<typename Profile>
+inline void generate_code(const float& value, CodeGenerator& codegen, Profile)
 {
-    if(codegen.program.opt.optimize_zero_floats && value == 0.0f)
+    if(Profile::optimize_zero_floats && value == 0.0f)
     {
         generate_code(static_cast<int8_t>(0), codegen);
     }
-    else if(codegen.program.opt.use_half_float)
+    else if(Profile::use_half_float)
     {
-        codegen.bw.emplace_u8(6);
-        codegen.bw.emplace_i16(static_cast<int16_t>(value * 16.0f));
+        codegen.bw.put_u8(6);
+        codegen.bw.put_i16(static_cast<int16_t>(value * 16.0f));
     }
     else
     {
         static_assert(std::numeric_limits<float>::is_iec559
             && sizeof(float) == sizeof(uint32_t), "IEEE 754 floating point expected.");
 
-        codegen.bw.emplace_u8(6);
-        codegen.bw.emplace_u32(reinterpret_cast<const uint32_t&>(value));
+        codegen.bw.put_u8(6);
+        codegen.bw.put_u32(reinterpret_cast<const uint32_t&>(value));
     }
 }
 
-inline void generate_code(const shared_ptr<Label>& label_ptr, CodeGenerator& codegen)
+inline void generate_code(const LabelRef&, CodeGenerator& codegen)
 {
-    codegen.bw.emplace_u8(1);
+    // The references are generated in the same order CodeGenerator::emit has found them.
+    codegen.bw.put_u8(1);
+    codegen.bw.put_i32(codegen.label_fixups[codegen.next_fixup++].value);
+}
 
-    auto emplace_local_offset = [&](int32_t offset)
+static int32_t label_reference(const CodeGenerator::LabelFixup& fixup, CodeGenerator& codegen)
+{
+    const Label& label = *fixup.label;
+
+    auto local_offset = [&](int32_t offset)
     {
         if(offset == 0)
-        {
-            codegen.program.error(nocontext, "compiled script references a label at the zero offset");
-            codegen.program.note(nocontext, "try using SCRIPT_NAME or NOP at the very top of your script");
-        }
-        codegen.bw.emplace_i32(-offset);
+            codegen.label_issues.emplace_back(CodeGenerator::LabelIssue::ZeroOffset, fixup.ccmd);
+        return -offset;
     };
 
-    if(!codegen.script->uses_local_offsets())
+    const auto& layout = codegen.script->layout;
+    const auto& target = *label.layout;
+    const uint32_t position = label.code_position.value();
+
+    if(!layout.uses_local_offsets)
     {
         if(codegen.program.opt.use_local_offsets)
         {
-            int32_t absolute_offset = static_cast<int32_t>(label_ptr->offset());
-            emplace_local_offset(absolute_offset);
+            int32_t absolute_offset = static_cast<int32_t>(target.code_offset + position);
+            return local_offset(absolute_offset);
         }
         else
         {
-            codegen.bw.emplace_i32(label_ptr->offset());
+            return static_cast<int32_t>(target.code_offset + position);
         }
     }
     else // current script is mission/stream
     {
-        if(label_ptr->script.lock()->uses_local_offsets())
+        if(target.uses_local_offsets)
         {
-            assert(label_ptr->script.lock()->on_the_same_space_as(*codegen.script));
-            int32_t local_offset = static_cast<int32_t>(label_ptr->distance_from_base());
-            emplace_local_offset(local_offset);
+            assert(label.script.lock()->on_the_same_space_as(*codegen.script));
+            int32_t distance = static_cast<int32_t>(target.distance_from_base + position);
+            return local_offset(distance);
         }
         else // label is within main block
         {
             if(codegen.program.opt.use_local_offsets)
-                codegen.program.error(*codegen.script, "cannot branch from this script into main block using local offsets [-mlocal-offsets]");
+                codegen.label_issues.emplace_back(CodeGenerator::LabelIssue::LocalOffsetIntoMain, fixup.ccmd);
 
-            codegen.bw.emplace_i32(label_ptr->offset());
+            return static_cast<int32_t>(target.code_offset + position);
         }
     }
 }
 
-inline void generate_code(const CompiledString& str, CodeGenerator& codegen)
+template<typename Profile>
+inline void generate_code(const CompiledString& str, CodeGenerator& codegen, Profile)
 {
+    const char* chars = codegen.arena().chars(str);
+
     switch(str.type)
     {
         case CompiledString::Type::TextLabel8:
-            assert(str.storage.size() <= 8);
-            if(codegen.program.opt.has_text_label_prefix)
-                codegen.bw.emplace_u8(9);
-            codegen.bw.emplace_chars(8, str.storage.c_str(), !str.preserve_case);
+            assert(str.size <= 8);
+            if(Profile::has_text_label_prefix)
+                codegen.bw.put_u8(9);
+            codegen.bw.put_chars(8, chars, !str.preserve_case);
             break;
         case CompiledString::Type::TextLabel16:
-            assert(str.storage.size() <= 16);
-            codegen.bw.emplace_u8(0xF);
-            codegen.bw.emplace_chars(16, str.storage.c_str(), !str.preserve_case);
+            assert(str.size <= 16);
+            codegen.bw.put_u8(0xF);
+            codegen.bw.put_chars(16, chars, !str.preserve_case);
             break;
         case CompiledString::Type::StringVar:
-            assert(str.storage.size() <= 127);
-            codegen.bw.emplace_u8(0xE);
-            codegen.bw.emplace_u8(static_cast<uint8_t>(str.storage.size()));
-            codegen.bw.emplace_chars(str.storage.size(), str.storage.c_str(), !str.preserve_case);
+            assert(str.size <= 127);
+            codegen.bw.put_u8(0xE);
+            codegen.bw.put_u8(static_cast<uint8_t>(str.size));
+            codegen.bw.put_chars(str.size, chars, !str.preserve_case);
             break;
         case CompiledString::Type::String128:
-            codegen.bw.emplace_chars(128, str.storage.c_str(), !str.preserve_case);
+            codegen.bw.put_chars(128, chars, !str.preserve_case);
             break;
         default:
             Unreachable();
     }
 }
 
-inline void generate_code(const CompiledVar& v, CodeGenerator& codegen)
+inline void generate_code(const CompiledVar& cvar, CodeGenerator& codegen)
 {
-    bool global = v.var->global;
+    const Var& var = codegen.arena().var(cvar.var);
+    bool global = var.global;
 
-    if(v.index == nullopt)
+    if(cvar.index_type == CompiledVar::IndexType::None)
     {
-        switch(v.var->type)
+        switch(var.type)
         {
             case VarType::Int:
             case VarType::Float:
-                codegen.bw.emplace_u8(global? 0x2 : 0x3);
+                codegen.bw.put_u8(global? 0x2 : 0x3);
                 break;
             case VarType::TextLabel:
-                codegen.bw.emplace_u8(global? 0xA : 0xB);
+                codegen.bw.put_u8(global? 0xA : 0xB);
                 break;
             case VarType::TextLabel16:
-                codegen.bw.emplace_u8(global? 0x10 : 0x11);
+                codegen.bw.put_u8(global? 0x10 : 0x11);
                 break;
             default:
                 Unreachable();
         }
 
-        codegen.bw.emplace_u16(static_cast<uint16_t>(global? v.var->offset() : v.var->index));
+        codegen.bw.put_u16(static_cast<uint16_t>(global? var.offset() : var.index));
     }
     else
     {
-        if(is<int32_t>(*v.index))
+        if(auto index = cvar.constant_index())
         {
-            switch(v.var->type)
+            switch(var.type)
             {
                 case VarType::Int:
                 case VarType::Float:
-                    codegen.bw.emplace_u8(global? 0x2 : 0x3);
+                    codegen.bw.put_u8(global? 0x2 : 0x3);
                     break;
                 case VarType::TextLabel:
-                    codegen.bw.emplace_u8(global? 0xA : 0xB);
+                    codegen.bw.put_u8(global? 0xA : 0xB);
                     break;
                 case VarType::TextLabel16:
-                    codegen.bw.emplace_u8(global? 0x10 : 0x11);
+                    codegen.bw.put_u8(global? 0x10 : 0x11);
                     break;
                 default:
                     Unreachable();
             }
 
-            auto actual_index = get<int32_t>(*v.index) * Var::space_taken(v.var->type);
-            codegen.bw.emplace_u16(static_cast<uint16_t>(global? v.var->offset() + actual_index * 4 : v.var->index + actual_index));
+            auto actual_index = *index * Var::space_taken(var.type);
+            codegen.bw.put_u16(static_cast<uint16_t>(global? var.offset() + actual_index * 4 : var.index + actual_index));
         }
         else
         {
-            auto& indexVar = get<shared_ptr<Var>>(*v.index);
-            switch(v.var->type)
+            auto& indexVar = codegen.arena().var(*cvar.var_index());
+            switch(var.type)
             {
                 case VarType::Int:
                 case VarType::Float:
-                    codegen.bw.emplace_u8(global? 0x7 : 0x8);
+                    codegen.bw.put_u8(global? 0x7 : 0x8);
                     break;
                 case VarType::TextLabel:
-                    codegen.bw.emplace_u8(global? 0xC : 0xD);
+                    codegen.bw.put_u8(global? 0xC : 0xD);
                     break;
                 case VarType::TextLabel16:
-                    codegen.bw.emplace_u8(global? 0x12 : 0x13);
+                    codegen.bw.put_u8(global? 0x12 : 0x13);
                     break;
                 default:
                     Unreachable();
             }
 
             auto ivartype = [&]() -> uint8_t {
-                switch(v.var->type)
+                switch(var.type)
                 {
                     case VarType::Int: return 0;
                     case VarType::Float: return 1;
@@ -429,34 +513,75 @@ inline void generate_code(const CompiledVar& v, CodeGenerator& codegen)
                 }
             }();
 
-            codegen.bw.emplace_u16(static_cast<uint16_t>(global? v.var->offset() : v.var->index));
-            codegen.bw.emplace_u16(static_cast<uint16_t>(indexVar->global? indexVar->offset() : indexVar->index));
-            codegen.bw.emplace_u8(static_cast<uint8_t>(v.var->count.value()));
-            codegen.bw.emplace_u8((static_cast<uint8_t>(ivartype) & 0x7F) | (indexVar->global << 7));
+            codegen.bw.put_u16(static_cast<uint16_t>(global? var.offset() : var.index));
+            codegen.bw.put_u16(static_cast<uint16_t>(indexVar.global? indexVar.offset() : indexVar.index));
+            codegen.bw.put_u8(static_cast<uint8_t>(var.count.value()));
+            codegen.bw.put_u8((static_cast<uint8_t>(ivartype) & 0x7F) | (indexVar.global << 7));
         }
     }
 }
 
-inline void generate_code(const ArgVariant& varg, CodeGenerator& codegen)
+template<typename Profile>
+inline void generate_code(const ArgVariant& varg, CodeGenerator& codegen, Profile profile)
 {
-    return visit_one(varg, [&](const auto& arg) { return ::generate_code(arg, codegen); });
+    return visit_one(varg, [&](const auto& arg) { return ::generate_code(arg, codegen, profile); });
 }
 
-inline void generate_code(const CompiledCommand& ccmd, CodeGenerator& codegen)
+/// Gets the opcode of `ccmd`, if it has any.
+template<typename Profile>
+static optional<uint16_t> find_opcode(const CompiledCommand& ccmd, const CodeGenerator& codegen, Profile)
 {
     optional<uint16_t> opcode;
 
-    if(codegen.oatc)
+    if(Profile::uses_oatc)
         opcode = codegen.oatc->find_opcode(ccmd.command);
 
     if(opcode == nullopt)
         opcode = ccmd.command.id;
 
-    if(opcode == nullopt)
-        codegen.program.fatal_error(nocontext, "could not compile command {}, no id or no hash [-moatc]", ccmd.command.name);
+    return opcode;
+}
+
+template<typename Profile>
+static size_t emit_command(const CompiledCommand& ccmd, CodeGenerator& codegen, Profile profile)
+{
+    if(find_opcode(ccmd, codegen, profile) == nullopt)
+    {
+        // Reported by CodeGenerator::report_issues. Keep going to find the label positions anyway.
+        if(codegen.missing_opcode == nullptr)
+            codegen.missing_opcode = std::addressof(ccmd);
+    }
 
-    codegen.bw.emplace_u16(*opcode | (ccmd.not_flag? 0x8000 : 0x0000));
-    for(auto& arg : ccmd.args) ::generate_code(arg, codegen);
+    size_t size = sizeof(uint16_t);
+    for(auto& arg : codegen.arena().args(ccmd))
+    {
+        if(is<LabelRef>(arg))
+        {
+            auto& label = codegen.arena().label(get<LabelRef>(arg));
+            codegen.label_fixups.push_back(CodeGenerator::LabelFixup { &label, std::addressof(ccmd), 0 });
+        }
+        size += ::compiled_size(arg, profile);
+    }
+
+    return size;
+}
+
+template<typename Profile>
+inline void generate_code(const CompiledCommand& ccmd, CodeGenerator& codegen, Profile profile)
+{
+    // A command without opcode is reported by CodeGenerator::report_issues, before any generation.
+    const uint16_t opcode = find_opcode(ccmd, codegen, profile).value_or(0);
+    const auto args = codegen.arena().args(ccmd);
+
+    // The arguments are emplaced without checking for room, thus make room for the whole command.
+    size_t size = sizeof(uint16_t);
+    for(auto& arg : args) size += ::compiled_size(arg, profile);
+    codegen.bw.reserve(size);
+
+    const size_t begin = codegen.bw.current_offset();
+    codegen.bw.put_u16(opcode | (ccmd.not_flag? 0x8000 : 0x0000));
+    for(auto& arg : args) ::generate_code(arg, codegen, profile);
+    assert(codegen.bw.current_offset() == begin + size);
 }
 
 inline void generate_code(const CompiledLabelDef&, CodeGenerator&)
@@ -466,7 +591,7 @@ inline void generate_code(const CompiledLabelDef&, CodeGenerator&)
 
 inline void generate_code(const CompiledHex& hex, CodeGenerator& codegen)
 {
-    codegen.bw.emplace_bytes(hex.data.size(), hex.data.data());
+    codegen.bw.emplace_bytes(hex.size, codegen.arena().bytes(hex));
 }
 
 static void generate_skipper(CodeGeneratorData& codegen, int32_t skip_bytes, bool force_global_offset)//+8 +12
@@ -674,7 +799,52 @@ inline void CustomHeaderOATC::generate_code(CodeGeneratorData& codegen) const
     }
 }
 
-inline void generate_code(const CompiledData& data, CodeGenerator& codegen)
+/// Things whose encoding does not depend on the profile.
+template<typename T, typename Profile>
+inline void generate_code(const T& x, CodeGenerator& codegen, Profile)
+{
+    return ::generate_code(x, codegen);
+}
+
+template<typename Profile>
+inline void generate_code(const CompiledData& data, CodeGenerator& codegen, Profile profile)
 {
-    return visit_one(data.data, [&](const auto& data) { return ::generate_code(data, codegen); });
+    return visit_one(data.data, [&](const auto& data) { return ::generate_code(data, codegen, profile); });
+}
+
+template<typename Functor>
+static void visit_profile(const CodeGenerator& codegen, Functor functor)
+{
+    using std::true_type;
+    using std::false_type;
+    auto& opt = codegen.program.opt;
+
+    auto with_oatc = [&](auto zero_floats, auto half_float, auto text_label_prefix)
+    {
+        if(codegen.oatc)
+            functor(EmitProfile<decltype(zero_floats)::value, decltype(half_float)::value, decltype(text_label_prefix)::value, true>());
+        else
+            functor(EmitProfile<decltype(zero_floats)::value, decltype(half_float)::value, decltype(text_label_prefix)::value, false>());
+    };
+
+    auto with_text_label_prefix = [&](auto zero_floats, auto half_float)
+    {
+        if(opt.has_text_label_prefix)
+            with_oatc(zero_floats, half_float, true_type());
+        else
+            with_oatc(zero_floats, half_float, false_type());
+    };
+
+    auto with_half_float = [&](auto zero_floats)
+    {
+        if(opt.use_half_float)
+            with_text_label_prefix(zero_floats, true_type());
+        else
+            with_text_label_prefix(zero_floats, false_type());
+    };
+
+    if(opt.optimize_zero_floats)
+        with_half_float(true_type());
+    else
+        with_half_float(false_type());
 }
@@ -20,27 +20,62 @@ public:
     const shared_ptr<const Script>  script;
     const CustomHeaderOATC*         oatc; // may be null for nullopt
 
+    /// Problems found by `resolve_labels` on label references.
+    enum class LabelIssue : uint8_t
+    {
+        ZeroOffset,             //< Reference to the zero offset, which has another meaning when local.
+        LocalOffsetIntoMain,    //< Reference into the main block using local offsets.
+    };
+
+    /// Label reference found by `emit`, whose value is computed by `resolve_labels`.
+    struct LabelFixup
+    {
+        const Label*            label;      //< Referenced label.
+        const CompiledCommand*  ccmd;       //< Command which references the label.
+        int32_t                 value;      //< Value to be generated for the reference.
+    };
+
+    /// Label references found by `emit`, in the order they are generated.
+    std::vector<LabelFixup> label_fixups;
+
+    /// Index in `label_fixups` of the next label reference to be generated by `generate`.
+    size_t next_fixup = 0;
+
+    /// Problems found by `resolve_labels`, along the command where they were found, to be reported by `report_issues`.
+    std::vector<std::pair<LabelIssue, const CompiledCommand*>> label_issues;
+
+    /// First command found by `emit` which has no opcode, to be reported by `report_issues`.
+    const CompiledCommand* missing_opcode = nullptr;
+
 private:
     std::vector<CompiledData>       compiled;
+    IRArena                         ir_arena;
 
 public:
-    explicit CodeGenerator(shared_ptr<const Script> script_, std::vector<CompiledData>&& compiled, ProgramContext& program) :
-        program(program), script(std::move(script_)), compiled(std::move(compiled)), oatc(nullptr)
+    explicit CodeGenerator(shared_ptr<const Script> script_, std::vector<CompiledData>&& compiled, IRArena&& arena,
+                           ProgramContext& program) :
+        program(program), script(std::move(script_)), compiled(std::move(compiled)), ir_arena(std::move(arena)), oatc(nullptr)
     {
     }
 
     explicit CodeGenerator(CompilerContext&& context, ProgramContext& program) : // consumes the context
-        CodeGenerator(std::move(context.script), std::move(context).get_data(), program)
+        CodeGenerator(std::move(context.script), std::move(context).get_data(), std::move(context).get_arena(), program)
     {}
 
-    /// Finds the `Label::local_offsets` for all labels that are inside this script.
+    /// Lays out the bytecode of this script, finding the `Label::code_position` for all labels that are inside it,
+    /// and the label references in it.
+    ///
+    /// No bytecode is generated yet. It is generated by `generate`, straight into its final location, once the
+    /// script offsets and the value of the label references are known.
     ///
     /// \returns the size of this script.
     ///
+    /// Problems are not reported by this method, but by `report_issues`.
+    ///
     /// \warning This method is not thread-safe because it modifies states! It modifies label objects which may be
-    /// in use by other code generation units.
+    /// in use by other code generation units. Still, different code generators may emit at the same time.
     ///
-    uint32_t compute_labels();
+    uint32_t emit();
 
     /// Assigns an OATC lookup to this code generator.
     ///
@@ -49,17 +84,36 @@ public:
     /// \warning This method is not thread-safe.
     void set_oatc(const CustomHeaderOATC& oatc) { this->oatc = std::addressof(oatc); }
 
-    /// Generates the code.
-    void generate();
-    
-    /// Gets the resulting buffer of the generation.
-    const void* buffer() const { return this->bw.buffer(); }
+    /// Computes the value of the label references found by `emit`.
+    ///
+    /// Must be called after the script offsets are computed (see `Script::compute_script_offsets`).
+    ///
+    /// This method is thread-safe as long as each thread works on a different code generator. Problems are not
+    /// reported by it, but by `report_issues`.
+    void resolve_labels();
 
-    /// Gets the size of the resulting buffer of the generation.
-    size_t buffer_size() const { return this->bw.buffer_size(); }
+    /// Generates the bytecode of this script into the `script->code_size` bytes at `output`
+    /// (e.g. the memory mapped output file). Must be called after `resolve_labels`.
+    ///
+    /// This method is thread-safe as long as each thread works on a different code generator.
+    void generate(void* output);
 
+    /// Reports the problems found by `emit` and `resolve_labels`.
+    ///
+    /// \warning This method is not thread-safe.
+    void report_issues();
+    
     ///
     const std::vector<CompiledData>& ir() const { return this->compiled; };
+
+    /// Gets the IR for transformation. Must not be changed after `emit`.
+    std::vector<CompiledData>& ir() { return this->compiled; };
+
+    /// Gets the storage of the IR, where the things referenced by handles in `ir` are.
+    const IRArena& arena() const { return this->ir_arena; }
+
+    /// Gets the storage of the IR for transformation. Must not be changed after `emit`.
+    IRArena& arena() { return this->ir_arena; }
 };
 
 /// Converts intermediate of pure-data things (such as the SCM header) into a bytecode.
@@ -83,14 +137,11 @@ public:
         program(program), compiled(compiled), script(std::move(script)), script_offset(script_offset)
     {}
 
-    /// Generates the data.
-    void generate();
+    /// Generates the data into the `compiled_size()` bytes at `output` (e.g. the memory mapped output file).
+    void generate(void* output);
 
-    /// Gets the resulting buffer of the generation.
-    const void* buffer() const { return this->bw.buffer(); }
-
-    /// Gets the size of the resulting buffer of the generation.
-    size_t buffer_size() const { return this->bw.buffer_size(); }
+    /// Gets the size of the generated data.
+    size_t compiled_size() const;
 };
 
 
@@ -111,6 +162,7 @@ public:
 private:
     uint16_t starting_opcode;
     std::vector<std::pair<const Command*, uint16_t>> ordinal_commands;
+    std::unordered_map<const Command*, uint16_t> ordinal_index; //< Same as `ordinal_commands`, for lookup.
 };
 
 /// List of headers for a single script.
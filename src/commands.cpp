@@ -3,13 +3,135 @@
 #include "program.hpp"
 #include "symtable.hpp"
 
+/// Memoizes the alternator resolutions of `Commands::match` by argument signature.
+///
+/// Expressions such as `x = y` or `x += 1.0` resolve the same handful of argument shapes
+/// over and over, so once a shape is resolved to a command we can try that command alone.
+struct Commands::MatchCache
+{
+    struct Key
+    {
+        const Alternator* alternator;
+        uint64_t          signature;
+
+        bool operator==(const Key& rhs) const
+        {
+            return this->alternator == rhs.alternator && this->signature == rhs.signature;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const
+        {
+            return std::hash<const void*>()(key.alternator) ^ std::hash<uint64_t>()(key.signature);
+        }
+    };
+
+    optional<const Command*> find(const Key& key) const
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(this->mutex);
+        auto it = this->entries.find(key);
+        if(it != this->entries.end())
+            return it->second;
+        return nullopt;
+    }
+
+    void insert(const Key& key, const Command* command)
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(this->mutex);
+        this->entries.emplace(key, command);
+    }
+
+private:
+    mutable std::shared_timed_mutex mutex;
+    std::unordered_map<Key, const Command*, KeyHash> entries;
+};
+
+void Enum::defer(const string_view& name, int32_t value)
+{
+    Expects(!this->deferred.empty() || this->values_.empty());
+    this->deferred.emplace_back(static_cast<uint32_t>(this->deferred_names.size()), value);
+    this->deferred_names.append(name.data(), name.size()).push_back('\0');
+    this->deferred_hashes.emplace_back(Enum::hash(name));
+}
+
+optional<int32_t> Enum::find(const string_view& value) const
+{
+    if(!this->is_materialized.load(std::memory_order_acquire))
+    {
+        // The deferred buffers are released once materialized, so hold them while looking into them.
+        std::shared_lock<std::shared_timed_mutex> lock(this->deferred_mutex);
+        if(!this->is_materialized.load(std::memory_order_relaxed))
+        {
+            if(!this->deferred.empty())
+            {
+                std::call_once(this->indexed, [this] {
+                    std::sort(this->deferred_hashes.begin(), this->deferred_hashes.end());
+                });
+
+                // Only materialize when the constant is (likely to be) part of this enum. Until then
+                // there's nothing else in `values_`, which cannot be materialized while we hold the lock.
+                if(!std::binary_search(this->deferred_hashes.begin(), this->deferred_hashes.end(), Enum::hash(value)))
+                    return nullopt;
+            }
+
+            lock.unlock();
+            this->materialize();
+        }
+    }
+
+    auto it = values_.find(value);
+    if(it != values_.end())
+        return it->second;
+    return nullopt;
+}
+
+auto Enum::values() const -> const insensitive_map<std::string, int32_t>&
+{
+    this->materialize();
+    return this->values_;
+}
+
+auto Enum::values() -> insensitive_map<std::string, int32_t>&
+{
+    this->materialize();
+    return this->values_;
+}
+
+void Enum::materialize() const
+{
+    std::call_once(this->materialized, [this] {
+        std::unique_lock<std::shared_timed_mutex> lock(this->deferred_mutex);
+
+        for(auto& pair : this->deferred)
+            this->values_.emplace(&this->deferred_names[pair.first], pair.second);
+
+        // Everything is in `values_` now, so the deferred buffers are of no use anymore.
+        std::string().swap(this->deferred_names);
+        std::vector<std::pair<uint32_t, int32_t>>().swap(this->deferred);
+        std::vector<uint32_t>().swap(this->deferred_hashes);
+
+        this->is_materialized.store(true, std::memory_order_release);
+    });
+}
+
+uint32_t Enum::hash(const string_view& name)
+{
+    return static_cast<uint32_t>(ihash()(name));
+}
+
+Commands::Commands(Commands&&) = default;
+Commands::~Commands() = default;
+
 Commands::Commands(transparent_set<Command>&& commands_,
                    insensitive_map<std::string, std::vector<const Command*>>&& alternators_,
                    transparent_map<std::string, EntityType>&& entities_,
                    transparent_map<std::string, shared_ptr<Enum>>&& enums_)
 
     : commands(std::move(commands_)), alternators(std::move(alternators_)),
-      enums(std::move(enums_)), entities(std::move(entities_))
+      enums(std::move(enums_)), entities(std::move(entities_)),
+      match_cache(std::make_unique<MatchCache>())
 {
     auto it_defaultmodel = this->enums.find("DEFAULTMODEL");
     auto it_model       = this->enums.find("MODEL");
@@ -94,7 +216,7 @@ void Commands::add_default_models(const insensitive_map<std::string, uint32_t>&
 {
     for(auto& model_pair : default_models)
     {
-        this->enum_defaultmodels->values.emplace(model_pair);
+        this->enum_defaultmodels->values().emplace(model_pair);
     }
 }
 
@@ -163,9 +285,15 @@ using MatchFailure = Commands::MatchFailure;
 
 struct TagVar
 {
+    const SyntaxTree& node;
     string_view ident;
 };
 
+struct TagText
+{
+    const SyntaxTree& node;
+};
+
 static auto maybe_var_identifier(const string_view& ident, const Command::Arg& arginfo) -> optional<std::pair<string_view, bool>>
 {
     if(arginfo.type != ArgType::TextLabel && arginfo.type != ArgType::TextLabel16 && arginfo.type != ArgType::String)
@@ -297,7 +425,7 @@ static auto match_arg(const Commands& commands, const shared_ptr<const SyntaxTre
 
     if(auto var_ident = maybe_var_identifier(arg.ident, arginfo))
     {
-        auto opt_token = Miss2Identifier::match(var_ident->first, options);
+        auto opt_token = arg.node.identifier(var_ident->first, options);
         if(!opt_token)
         {
             switch(opt_token.error())
@@ -376,9 +504,11 @@ static auto match_arg(const Commands& commands, const shared_ptr<const SyntaxTre
 }
 
 static auto match_arg(const Commands& commands, const shared_ptr<const SyntaxTree>& hint,
-                      string_view text, const Command::Arg& arginfo, const SymTable& symtable,
+                      const TagText& arg, const Command::Arg& arginfo, const SymTable& symtable,
                       const shared_ptr<Scope>& scope_ptr, const Options& options) -> expected<const Command::Arg*, MatchFailure>
 {
+    auto text = arg.node.text();
+
     switch(arginfo.type)
     {
         case ArgType::Label:
@@ -407,7 +537,7 @@ static auto match_arg(const Commands& commands, const shared_ptr<const SyntaxTre
         case ArgType::TextLabel16:
         case ArgType::String:
         {
-            auto exp_var = match_arg(commands, hint, TagVar { text }, arginfo, symtable, scope_ptr, options);
+            auto exp_var = match_arg(commands, hint, TagVar { arg.node, text }, arginfo, symtable, scope_ptr, options);
             if(exp_var)
                 return exp_var;
             else if(exp_var.error().reason == MatchFailure::NoSuchVar && arginfo.allow_constant)
@@ -448,7 +578,7 @@ static auto match_arg(const Commands& commands, const shared_ptr<const SyntaxTre
                 }
             }
 
-            auto exp_var = match_arg(commands, hint, TagVar { text }, arginfo, symtable, scope_ptr, options);
+            auto exp_var = match_arg(commands, hint, TagVar { arg.node, text }, arginfo, symtable, scope_ptr, options);
             if(exp_var || exp_var.error().reason != MatchFailure::NoSuchVar)
                 return exp_var;
             else if(arginfo.uses_enum(commands.get_scriptstream_enum()) && symtable.find_streamed_id(text))
@@ -477,7 +607,7 @@ static auto match_arg(const Commands& commands, const shared_ptr<const SyntaxTre
         case NodeType::Float:
             return match_arg(commands, hint, 0.0f, arginfo, symtable, scope_ptr, options);
         case NodeType::Text:
-            return match_arg(commands, hint, arg.text(), arginfo, symtable, scope_ptr, options);
+            return match_arg(commands, hint, TagText { arg }, arginfo, symtable, scope_ptr, options);
         case NodeType::String:
             if(arginfo.type == ArgType::String || arginfo.type == ArgType::TextLabel32
             || (arginfo.type == ArgType::Param && arginfo.allow_text_label))
@@ -524,14 +654,137 @@ auto Commands::match(const Alternator& alternator, optional<const SyntaxTree&> c
                      const SymTable& symtable, const shared_ptr<Scope>& scope_ptr, const Options& options) const
                                                                                                 -> expected<const Command*, MatchFailure>
 {
+    auto signature = this->match_signature(args, symtable, scope_ptr, options);
+
+    if(signature)
+    {
+        // A hit only tells which alternative to try first. If it doesn't match (e.g. an array index out of
+        // range), go through the full path, so the diagnostic is the same as without memoization.
+        if(auto opt_cached = match_cache->find({ std::addressof(alternator), *signature }))
+        {
+            if(auto opt_command = this->match(**opt_cached, cmdnode, args, symtable, scope_ptr, options))
+                return opt_command;
+        }
+    }
+
     for(auto& cmd : alternator)
     {
         if(auto opt_command = this->match(*cmd, cmdnode, args, symtable, scope_ptr, options))
+        {
+            if(signature)
+                match_cache->insert({ std::addressof(alternator), *signature }, *opt_command);
             return opt_command;
+        }
     }
     return make_unexpected(MatchFailure { hint_from(cmdnode), MatchFailure::NoAlternativeMatch });
 }
 
+auto Commands::match_signature(const MatchArgumentList& args, const SymTable& symtable,
+                               const shared_ptr<Scope>& scope_ptr, const Options& options) const -> optional<uint64_t>
+{
+    // The signature holds one byte per argument plus the argument count on the most significant byte.
+    // Each byte must carry everything `match_arg` depends on for the argument to match or not:
+    //
+    //   0x01 = integer literal, 0x02 = float literal, 0x03 = string literal,
+    //   0x80 | (global << 6) | (VarType << 3) | (0 = not indexed, 1 = indexed by literal, 2 = indexed by variable).
+    //
+    // Texts which aren't plainly variables (e.g. constants, labels, $-prefixed) are not memoized, since
+    // their outcome depends on the context of the argument being matched.
+
+    enum : uint8_t { SigInt = 0x01, SigFloat = 0x02, SigString = 0x03, SigVar = 0x80 };
+
+    if(args.size() >= 8)
+        return nullopt;
+
+    uint64_t signature = uint64_t(args.size()) << 56;
+
+    for(size_t i = 0; i < args.size(); ++i)
+    {
+        uint8_t kind;
+
+        if(is<int32_t>(args[i]))
+        {
+            kind = SigInt;
+        }
+        else if(is<float>(args[i]))
+        {
+            kind = SigFloat;
+        }
+        else
+        {
+            auto& arg = *get<const SyntaxTree*>(args[i]);
+            switch(arg.type())
+            {
+                case NodeType::Integer:
+                    kind = SigInt;
+                    break;
+                case NodeType::Float:
+                    kind = SigFloat;
+                    break;
+                case NodeType::String:
+                    kind = SigString;
+                    break;
+                case NodeType::Text:
+                {
+                    auto text = arg.text();
+                    if(text.empty() || text.front() == '$')
+                        return nullopt;
+
+                    auto opt_token = arg.identifier(text, options);
+                    if(!opt_token)
+                        return nullopt;
+
+                    auto opt_var = symtable.find_var(opt_token->identifier, scope_ptr);
+                    if(!opt_var)
+                        return nullopt;
+
+                    // Constants and labels are resolved before variables by some argument types. Their names
+                    // never contain an index, so checking the name of the variable once is enough for any text
+                    // referring to it. The symbol tables are complete by the time commands are matched.
+                    auto& name_clash = (*opt_var)->name_clash;
+                    uint8_t clash = name_clash.load(std::memory_order_relaxed);
+                    if(clash == 0)
+                    {
+                        auto name = opt_token->identifier;
+                        bool clashes = symtable.find_constant(name) || this->find_constant_all(name) || symtable.find_label(name);
+                        clash = clashes? 2 : 1;
+                        name_clash.store(clash, std::memory_order_relaxed);
+                    }
+                    if(clash == 2)
+                        return nullopt;
+
+                    uint8_t indexing = 0;
+                    if(opt_token->index == nullopt)
+                    {
+                        if((*opt_var)->count != nullopt)
+                            return nullopt;
+                    }
+                    else if(is<size_t>(*opt_token->index))
+                    {
+                        indexing = 1;
+                    }
+                    else
+                    {
+                        auto opt_varidx = symtable.find_var(get<string_view>(*opt_token->index), scope_ptr);
+                        if(!opt_varidx || (*opt_varidx)->type != VarType::Int || (*opt_varidx)->count)
+                            return nullopt;
+                        indexing = 2;
+                    }
+
+                    kind = SigVar | ((*opt_var)->global << 6) | (static_cast<uint8_t>((*opt_var)->type) << 3) | indexing;
+                    break;
+                }
+                default:
+                    return nullopt;
+            }
+        }
+
+        signature |= uint64_t(kind) << (8 * i);
+    }
+
+    return signature;
+}
+
 auto Commands::match(const Command& command, optional<const SyntaxTree&> cmdnode, const MatchArgumentList& args,
                      const SymTable& symtable, const shared_ptr<Scope>& scope_ptr, const Options& options) const
                                                                                                -> expected<const Command*, MatchFailure>
@@ -596,9 +849,9 @@ void Commands::annotate(const AnnotateArgumentList& args, const Command& command
 {
     // Expects all args to match command.args!
 
-    auto find_var = [&](const string_view& value) -> optional<VarAnnotation>
+    auto find_var = [&](const SyntaxTree& node, const string_view& value) -> optional<VarAnnotation>
     {
-        auto opt_token = Miss2Identifier::match(value, program.opt);
+        auto opt_token = node.identifier(value, program.opt);
         if(!opt_token)
             return nullopt;
 
@@ -749,7 +1002,7 @@ void Commands::annotate(const AnnotateArgumentList& args, const Command& command
                 {
                     if(auto opt_match = maybe_var_identifier(node.text(), arginfo))
                     {
-                        if(auto opt_var = find_var(opt_match->first))
+                        if(auto opt_var = find_var(node, opt_match->first))
                         {
                             annotate_var(node, *opt_var);
                             break;
@@ -811,7 +1064,7 @@ void Commands::annotate(const AnnotateArgumentList& args, const Command& command
                     {
                         if(auto opt_match = maybe_var_identifier(node.text(), arginfo))
                         {
-                            if(auto opt_var = find_var(opt_match->first))
+                            if(auto opt_var = find_var(node, opt_match->first))
                             {
                                 if(!opt_var->base->is_text_var() || opt_match->second) // if text var, shall begin with $
                                 {
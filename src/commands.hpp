@@ -19,22 +19,55 @@ enum class ArgType : uint8_t
 using EntityType = uint16_t;
 
 /// Stores constant values associated with a identifiers.
+///
+/// Constants may be deferred (see `defer`) so the lookup map is only built when the enum is first looked up.
+/// Large enums (e.g. SOUND) are then only materialized if the script being compiled actually uses them.
 struct Enum
 {
-    insensitive_map<std::string, int32_t> values;
     bool is_global = false;
 
     explicit Enum(insensitive_map<std::string, int32_t> values, bool is_global) :
-        values(std::move(values)), is_global(is_global)
+        is_global(is_global), values_(std::move(values))
     {}
 
-    optional<int32_t> find(const string_view& value) const
-    {
-        auto it = values.find(value);
-        if(it != values.end())
-            return it->second;
-        return nullopt;
-    }
+    Enum(const Enum&) = delete;
+
+    /// Adds the constant `name` into this enum without materializing it into `values()`.
+    ///
+    /// \warning This method is not thread-safe and must not be called after the enum is first looked up.
+    /// \warning Constants cannot be deferred into an enum constructed with values.
+    void defer(const string_view& name, int32_t value);
+
+    /// Finds the value of the constant `value`.
+    ///
+    /// Deferred constants are materialized on demand, so this method is thread-safe.
+    optional<int32_t> find(const string_view& value) const;
+
+    /// Gets all the constants of this enum, materializing the deferred ones.
+    const insensitive_map<std::string, int32_t>& values() const;
+
+    /// Gets all the constants of this enum, materializing the deferred ones.
+    ///
+    /// \warning This method is not thread-safe.
+    insensitive_map<std::string, int32_t>& values();
+
+private:
+    /// Case-insensitive hash of a constant name.
+    static uint32_t hash(const string_view& name);
+
+    /// Materializes the deferred constants into `values_`.
+    void materialize() const;
+
+private:
+    mutable insensitive_map<std::string, int32_t> values_;
+
+    mutable std::once_flag                          indexed;         //< Whether `deferred_hashes` is sorted.
+    mutable std::once_flag                          materialized;    //< Whether `deferred` is in `values_`.
+    mutable std::atomic<bool>                       is_materialized { false };
+    mutable std::shared_timed_mutex                 deferred_mutex;  //< Guards the release of the deferred buffers below.
+    mutable std::string                             deferred_names;  //< Null-separated names of deferred constants.
+    mutable std::vector<std::pair<uint32_t, int32_t>> deferred;      //< (offset in deferred_names, value) pairs.
+    mutable std::vector<uint32_t>                   deferred_hashes; //< Name hashes, to answer lookup misses quickly.
 };
 
 /// Stores command information.
@@ -140,6 +173,91 @@ struct Command
     }
 };
 
+/// Commands of a configuration built into the executable, already linked together (see GTA3SC_BUILTIN_CONFIG in CMakeLists.txt).
+///
+/// These tables are generated by the compiler itself from the XML files, so `Commands::from_builtin` skips both the parsing
+/// and the name resolution done by `Commands::from_xml`. A configuration reads a different list of XML files depending on
+/// the options (e.g. cleo.xml with -fcleo), hence each table is the union of all such lists, with each entry having a mask
+/// of the lists it is part of.
+struct BuiltinCommands
+{
+    struct Constant
+    {
+        const char* name;
+        int32_t     value;
+    };
+
+    struct Enum
+    {
+        uint8_t         lists;          //< Mask of the XML lists containing this enum.
+        uint16_t        slot;           //< Index used by `Arg::enum_slot` to refer to this enum.
+        const char*     name;
+        bool            is_global;
+        const Constant* constants;
+        uint32_t        num_constants;
+    };
+
+    struct Arg
+    {
+        ArgType     type;
+        bool        optional;
+        bool        is_output;
+        bool        is_ref;
+        bool        allow_constant;
+        bool        allow_global_var;
+        bool        allow_local_var;
+        bool        allow_text_label;
+        bool        allow_pointer;
+        bool        preserve_case;
+        EntityType  entity_type;
+        int32_t     enum_slot;          //< Slot of the enum used by this argument or -1 if none.
+    };
+
+    struct Command
+    {
+        uint8_t     lists;              //< Mask of the XML lists containing this command.
+        const char* name;
+        bool        supported;
+        bool        internal;
+        bool        extension;
+        int32_t     id;                 //< The opcode id or -1 if none.
+        int64_t     hash;               //< The command hash or -1 if none.
+        const Arg*  args;
+        uint32_t    num_args;
+    };
+
+    struct Alternator
+    {
+        uint8_t         lists;          //< Mask of the XML lists containing this alternator.
+        const char*     name;
+        const uint32_t* commands;       //< Indices of the alternatives in `BuiltinCommands::commands`.
+        uint32_t        num_commands;
+    };
+
+    struct Entity
+    {
+        uint8_t     lists;              //< Mask of the XML lists containing this entity.
+        const char* name;
+        EntityType  type;
+    };
+
+    const char*         config_name;
+    const char* const*  xml_lists;      //< The XML lists (files separated by ';') this table was built from.
+    uint32_t            num_xml_lists;
+    uint32_t            num_enum_slots;
+    const Enum*         enums;
+    uint32_t            num_enums;
+    const Command*      commands;
+    uint32_t            num_commands;
+    const Alternator*   alternators;
+    uint32_t            num_alternators;
+    const Entity*       entities;
+    uint32_t            num_entities;
+};
+
+/// All the command tables built into the executable, terminated by a null entry.
+extern const BuiltinCommands* const GTA3SC_BUILTIN_COMMANDS[];
+
 
 /// Stores the list of commands and alternators.
 class Commands
@@ -205,11 +323,28 @@ public:
                       transparent_map<std::string, shared_ptr<Enum>>&& enums);
 
     Commands(const Commands&) = delete;
-    Commands(Commands&&) = default;
+    Commands(Commands&&);
+    ~Commands();
 
-    static Commands from_xml(const std::string& config_name, const std::vector<fs::path>& xml_list);
+    /// Reads the commands, alternators and constants from the XML files at `xml_list`.
+    ///
+    /// If `builtin` is true, relative paths are taken from the configuration built into the executable
+    /// instead of `config_path()` (see `find_builtin_config`).
+    static Commands from_xml(const std::string& config_name, const std::vector<fs::path>& xml_list, bool builtin = false);
     // TODO ^ make the paths of xml_list absolute? i.e. move modifies to outside?
 
+    /// Builds the commands of the configuration `config_name` from the tables built into the executable.
+    ///
+    /// \returns nullopt if there are no tables for the XML files in `xml_list`, in which case `from_xml`
+    /// must be used.
+    static optional<Commands> from_builtin(const std::string& config_name, const std::vector<fs::path>& xml_list);
+
+    /// Generates the C++ source of the `BuiltinCommands` table named `symbol` for the configuration `config_name`.
+    ///
+    /// Each one of the `xml_lists` is read with `from_xml` from the configuration files built into the executable.
+    static std::string to_builtin_source(const std::string& config_name, const std::string& symbol,
+                                         const std::vector<std::vector<fs::path>>& xml_lists);
+
     /// Adds the default models associated with the program context into the DEFAULTMODEL enum.
     void add_default_models(const insensitive_map<std::string, uint32_t>&);
 
@@ -320,6 +455,15 @@ public:
         return false;
     }
 
+private:
+    struct MatchCache;
+
+    /// Finds the argument signature of `args` for use as a key in the `MatchCache`.
+    ///
+    /// \returns nullopt if the arguments are too complex to be memoized.
+    optional<uint64_t> match_signature(const MatchArgumentList& args, const SymTable&,
+                                       const shared_ptr<Scope>&, const Options&) const;
+
 private:
     transparent_set<Command> commands;
     insensitive_map<std::string, std::vector<const Command*>> alternators;
@@ -331,6 +475,8 @@ private:
     shared_ptr<Enum> enum_defaultmodels;
     shared_ptr<Enum> enum_scriptstream;
 
+    std::unique_ptr<MatchCache> match_cache; //< Alternator resolutions by argument signature.
+
 public:
     optional<const Command&> set_progress_total;
     optional<const Command&> set_total_number_of_missions;
@@ -27,25 +27,24 @@ void CompilerContext::compile()
     program.supported_or_fatal(nocontext, commands.goto_, "GOTO");
     program.supported_or_fatal(nocontext, commands.goto_if_false, "GOTO_IF_FALSE");
 
-    compile_label(script->top_label);
-    compile_label(script->start_label);
+    compile_label(arena.add_label(script->top_label));
+    compile_label(arena.add_label(script->start_label));
     return compile_statements(*script->tree);
 }
 
-shared_ptr<Label> CompilerContext::make_internal_label()
+LabelRef CompilerContext::make_internal_label()
 {
-    this->internal_labels.emplace_back(std::make_shared<Label>(this->current_scope, this->script));
-    return this->internal_labels.back();
+    return this->arena.make_label(this->current_scope, this->script);
 }
 
 void CompilerContext::compile_label(const SyntaxTree& label_node)
 {
-    return compile_label(label_node.annotation<shared_ptr<Label>>());
+    return compile_label(this->arena.add_label(label_node.annotation<shared_ptr<Label>>()));
 }
 
-void CompilerContext::compile_label(shared_ptr<Label> label_ptr)
+void CompilerContext::compile_label(LabelRef label)
 {
-    this->compiled.emplace_back(std::move(label_ptr));
+    this->compiled.emplace_back(label);
 }
 
 void CompilerContext::compile_command(const Command& command, ArgList args, bool not_flag)
@@ -59,7 +58,26 @@ void CompilerContext::compile_command(const Command& command, ArgList args, bool
         args.emplace_back(EOAL{});
     }
 
-    this->compiled.emplace_back(CompiledCommand{ not_flag, command, std::move(args) });
+    // The statement is located by its first node with text, the same way diagnostics on syntax trees are.
+    uint32_t source_begin = 0, source_end = 0;
+    if(const SyntaxTree* node = this->current_statement)
+    {
+        if(!node->has_text())
+        {
+            auto it = std::find_if(node->begin(), node->end(), [](const shared_ptr<SyntaxTree>& child) {
+                return child->has_text();
+            });
+            node = (it == node->end())? node : it->get();
+        }
+
+        if(node->has_text())
+        {
+            source_begin = static_cast<uint32_t>(node->get_token().begin);
+            source_end = static_cast<uint32_t>(node->get_token().end);
+        }
+    }
+
+    this->compiled.emplace_back(arena.add_command(not_flag, command, args.data(), args.size(), source_begin, source_end));
 }
 
 void CompilerContext::compile_command(const SyntaxTree& command_node, bool not_flag)
@@ -74,7 +92,7 @@ void CompilerContext::compile_command(const SyntaxTree& command_node, bool not_f
 
         if(commands.equal(command, commands.skip_cutscene_start_internal))
         {
-            this->label_skip_cutscene_end = any_cast<shared_ptr<Label>>(opt_annot->params[0]);
+            this->label_skip_cutscene_end = arena.add_label(any_cast<shared_ptr<Label>>(opt_annot->params[0]));
         }
 
         compile_command(command, get_args(opt_annot->command, opt_annot->params));
@@ -85,8 +103,8 @@ void CompilerContext::compile_command(const SyntaxTree& command_node, bool not_f
 
         if(commands.equal(command, commands.skip_cutscene_end) && this->label_skip_cutscene_end)
         {
-            compile_label(this->label_skip_cutscene_end);
-            this->label_skip_cutscene_end = nullptr;
+            compile_label(*this->label_skip_cutscene_end);
+            this->label_skip_cutscene_end = nullopt;
         }
 
         compile_command(command, get_args(command, command_node), not_flag);
@@ -107,6 +125,12 @@ void CompilerContext::compile_statements(const SyntaxTree& parent, size_t from_i
 
 void CompilerContext::compile_statement(const SyntaxTree& node, bool not_flag)
 {
+    auto guard = make_scope_guard([&, prev_statement = this->current_statement] {
+        this->current_statement = prev_statement;
+    });
+
+    this->current_statement = &node;
+
     switch(node.type())
     {
         case NodeType::Block:
@@ -186,7 +210,7 @@ void CompilerContext::compile_statement(const SyntaxTree& node, bool not_flag)
 
 void CompilerContext::compile_dump(const SyntaxTree& node)
 {
-    this->compiled.emplace_back(node.annotation<DumpAnnotation>().bytes);
+    this->compiled.emplace_back(arena.add_hex(node.annotation<DumpAnnotation>().bytes));
 }
 
 void CompilerContext::compile_scope(const SyntaxTree& scope_node)
@@ -264,7 +288,7 @@ void CompilerContext::compile_repeat(const SyntaxTree& repeat_node)
 
 void CompilerContext::compile_switch(const SyntaxTree& switch_node)
 {
-    auto continue_ptr = nullptr;
+    auto continue_ptr = nullopt;
     auto break_ptr = make_internal_label();
 
     loop_stack.emplace_back(LoopInfo{ continue_ptr, break_ptr });
@@ -281,8 +305,9 @@ void CompilerContext::compile_switch(const SyntaxTree& switch_node)
             case NodeType::CASE:
             {
                 auto value  = node.child(0).annotation<int32_t>();
-                auto& isveq = node.annotation<const SwitchCaseAnnotation&>().is_var_eq_int;
-                cases.emplace_back(value, isveq);
+                auto& annotation = node.annotation<const SwitchCaseAnnotation&>();
+                cases.emplace_back(value, annotation.is_var_eq_int);
+                cases.back().is_var_gt_int = annotation.is_var_gt_int;
                 break;
             }
 
@@ -347,6 +372,20 @@ void CompilerContext::compile_switch(const SyntaxTree& switch_node)
     {
         compile_switch_withop(switch_node, cases, break_ptr);
     }
+    else if(program.opt.optimize_switch && std::all_of(cases.begin(), cases.end(), [](const Case& c) {
+                return c.is_default() || c.is_var_gt_int != nullptr; }))
+    {
+        // Either a chain of comparisons or a binary search on the cases, whichever executes fewer commands
+        // on the worst case.
+        auto ranges = make_case_ranges(cases);
+        auto bsearch_cost = compile_switch_bsearch(switch_node, ranges, 0, ranges.size(),
+                                                   INT32_MIN, INT32_MAX, nullopt, true);
+
+        if(bsearch_cost < switch_ifchain_cost(cases))
+            compile_switch_bsearch(switch_node, cases, break_ptr);
+        else
+            compile_switch_ifchain(switch_node, cases, break_ptr);
+    }
     else
     {
         compile_switch_ifchain(switch_node, cases, break_ptr);
@@ -355,7 +394,7 @@ void CompilerContext::compile_switch(const SyntaxTree& switch_node)
     loop_stack.pop_back();
 }
 
-void CompilerContext::compile_switch_withop(const SyntaxTree& swnode, std::vector<Case>& cases, shared_ptr<Label> break_ptr)
+void CompilerContext::compile_switch_withop(const SyntaxTree& swnode, std::vector<Case>& cases, LabelRef break_ptr)
 {
     std::vector<Case*> sorted_cases;   // does not contain default, unlike `cases`
     sorted_cases.resize(cases.size());
@@ -385,7 +424,7 @@ void CompilerContext::compile_switch_withop(const SyntaxTree& swnode, std::vecto
 
     for(size_t i = 0; i < sorted_cases.size(); )
     {
-        std::vector<ArgVariant> args;
+        ArgList args;
         args.reserve(18);
 
         const Command& switch_op = (i == 0? switch_start : switch_continued);
@@ -396,7 +435,7 @@ void CompilerContext::compile_switch_withop(const SyntaxTree& swnode, std::vecto
             args.emplace_back(get_arg(swnode.child(0)));
             args.emplace_back(conv_int(sorted_cases.size()));
             args.emplace_back(conv_int(has_default));
-            args.emplace_back(has_default? case_default->target : break_ptr);
+            args.emplace_back(has_default? *case_default->target : break_ptr);
         }
 
         for(size_t k = 0; k < max_cases_here; ++k, ++i)
@@ -404,7 +443,7 @@ void CompilerContext::compile_switch_withop(const SyntaxTree& swnode, std::vecto
             if(i < sorted_cases.size())
             {
                 args.emplace_back(conv_int(*sorted_cases[i]->value));
-                args.emplace_back(sorted_cases[i]->target);
+                args.emplace_back(*sorted_cases[i]->target);
             }
             else
             {
@@ -418,7 +457,7 @@ void CompilerContext::compile_switch_withop(const SyntaxTree& swnode, std::vecto
 
     for(auto it = cases.begin(); it != cases.end(); ++it)
     {
-        compile_label(it->target);
+        compile_label(*it->target);
         if(std::next(it) == cases.end() || !std::next(it)->same_body_as(*it))
         {
             compile_statements(swnode.child(1), it->first_statement_id, it->last_statement_id);
@@ -428,7 +467,7 @@ void CompilerContext::compile_switch_withop(const SyntaxTree& swnode, std::vecto
     compile_label(break_ptr);
 }
 
-void CompilerContext::compile_switch_ifchain(const SyntaxTree& swnode, std::vector<Case>& cases, shared_ptr<Label> break_ptr)
+void CompilerContext::compile_switch_ifchain(const SyntaxTree& swnode, std::vector<Case>& cases, LabelRef break_ptr)
 {
     Case* default_case = nullptr;
 
@@ -478,12 +517,12 @@ void CompilerContext::compile_switch_ifchain(const SyntaxTree& swnode, std::vect
     {
         if(default_case->target)
         {
-            compile_command(*commands.goto_, { default_case->target });
+            compile_command(*commands.goto_, { *default_case->target });
         }
         else
         {
             default_case->target = make_internal_label();
-            compile_label(default_case->target);
+            compile_label(*default_case->target);
             compile_statements(swnode.child(1), default_case->first_statement_id, default_case->last_statement_id);
         }
     }
@@ -491,13 +530,184 @@ void CompilerContext::compile_switch_ifchain(const SyntaxTree& swnode, std::vect
     compile_label(break_ptr);
 }
 
+size_t CompilerContext::switch_ifchain_cost(const std::vector<Case>& cases)
+{
+    size_t cost = 0;
+
+    for(auto it = cases.begin(), next_it = cases.end(); it != cases.end(); it = next_it)
+    {
+        next_it = std::find_if(std::next(it), cases.end(), [&](const Case& c){
+            return !c.same_body_as(*it);
+        });
+
+        auto num_ifs = std::accumulate(it, next_it, size_t(0), [](size_t accum, const Case& c) {
+            return accum + (c.is_default()? 0 : 1);
+        });
+        auto has_default = std::any_of(it, next_it, [](const Case& c) { return c.is_default(); });
+
+        if(num_ifs > 8) // not possible using if-chain
+            return SIZE_MAX;
+
+        if(num_ifs)
+            cost += (num_ifs > 1? 1 : 0) + num_ifs + 1; // ANDOR, conditions and GOTO_IF_FALSE
+
+        if(num_ifs && has_default) // GOTO into the default body
+            cost += 1;
+    }
+
+    return cost;
+}
+
+auto CompilerContext::make_case_ranges(const std::vector<Case>& cases) -> std::vector<CaseRange>
+{
+    std::vector<const Case*> sorted_cases;
+    sorted_cases.reserve(cases.size());
+
+    for(auto& c : cases)
+    {
+        if(!c.is_default())
+            sorted_cases.emplace_back(std::addressof(c));
+    }
+
+    std::sort(sorted_cases.begin(), sorted_cases.end(), [](const Case* a, const Case* b) {
+        return *a->value < *b->value;
+    });
+
+    std::vector<CaseRange> ranges;
+    for(auto c : sorted_cases)
+    {
+        if(!ranges.empty() && int64_t(ranges.back().max) + 1 == *c->value && ranges.back().first->same_body_as(*c))
+            ranges.back().max = *c->value;
+        else
+            ranges.push_back(CaseRange { *c->value, *c->value, c });
+    }
+
+    return ranges;
+}
+
+void CompilerContext::compile_switch_bsearch(const SyntaxTree& swnode, std::vector<Case>& cases, LabelRef break_ptr)
+{
+    const Case* case_default = nullptr;
+
+    for(auto& c : cases)
+    {
+        c.target = make_internal_label();
+        if(c.is_default())
+            case_default = std::addressof(c);
+    }
+
+    auto ranges = make_case_ranges(cases);
+    compile_switch_bsearch(swnode, ranges, 0, ranges.size(), INT32_MIN, INT32_MAX,
+                           case_default? *case_default->target : break_ptr, false);
+
+    for(auto it = cases.begin(); it != cases.end(); ++it)
+    {
+        compile_label(*it->target);
+        if(std::next(it) == cases.end() || !std::next(it)->same_body_as(*it))
+        {
+            compile_statements(swnode.child(1), it->first_statement_id, it->last_statement_id);
+        }
+    }
+
+    compile_label(break_ptr);
+}
+
+size_t CompilerContext::compile_switch_bsearch(const SyntaxTree& swnode, const std::vector<CaseRange>& ranges, size_t begin, size_t end,
+                                               int64_t min, int64_t max, optional<LabelRef> default_ptr, bool dry_run)
+{
+    // Up to this many ranges, testing each of them in turn is about as cheap as splitting them further.
+    const size_t max_linear_ranges = 3;
+
+    if(end - begin > max_linear_ranges)
+    {
+        // Values greater than the pivot are searched on the upper half.
+        auto mid   = begin + (end - begin) / 2;
+        auto pivot = int64_t(ranges[mid].min) - 1;
+        auto upper_ptr = dry_run? nullopt : optional<LabelRef>(make_internal_label());
+
+        if(!dry_run)
+        {
+            compile_command(*ranges[mid].first->is_var_gt_int, { get_arg(swnode.child(0)), conv_int(pivot) }, true);
+            compile_command(*commands.goto_if_false, { *upper_ptr });
+        }
+
+        auto lower_cost = compile_switch_bsearch(swnode, ranges, begin, mid, min, pivot, default_ptr, dry_run);
+
+        if(!dry_run)
+            compile_label(*upper_ptr);
+
+        auto upper_cost = compile_switch_bsearch(swnode, ranges, mid, end, pivot + 1, max, default_ptr, dry_run);
+
+        return 2 + std::max(lower_cost, upper_cost);
+    }
+
+    size_t cost = 0;
+
+    // Each test jumps into the case body when it succeeds, thus the conditions are negated.
+    for(size_t i = begin; i < end && min <= max; ++i)
+    {
+        auto& range = ranges[i];
+        auto& c     = *range.first;
+
+        if(range.min <= min && range.max >= max)
+        {
+            if(!dry_run)
+                compile_command(*commands.goto_, { *c.target });
+            return cost + 1;
+        }
+        else if(range.min == range.max)
+        {
+            if(!dry_run)
+                compile_command(**c.is_var_eq_int, { get_arg(swnode.child(0)), conv_int(range.min) }, true);
+            cost += 2;
+        }
+        else if(range.min <= min)
+        {
+            if(!dry_run)
+                compile_command(*c.is_var_gt_int, { get_arg(swnode.child(0)), conv_int(range.max) });
+            cost += 2;
+        }
+        else if(range.max >= max)
+        {
+            if(!dry_run)
+                compile_command(*c.is_var_gt_int, { get_arg(swnode.child(0)), conv_int(range.min - 1) }, true);
+            cost += 2;
+        }
+        else
+        {
+            if(!dry_run)
+            {
+                compile_command(*commands.andor, { conv_int(21) });
+                compile_command(*c.is_var_gt_int, { get_arg(swnode.child(0)), conv_int(range.max) });
+                compile_command(*c.is_var_gt_int, { get_arg(swnode.child(0)), conv_int(range.min - 1) }, true);
+            }
+            cost += 4;
+        }
+
+        if(!dry_run)
+            compile_command(*commands.goto_if_false, { *c.target });
+
+        if(range.min <= min)
+            min = int64_t(range.max) + 1;
+    }
+
+    if(min <= max)
+    {
+        if(!dry_run)
+            compile_command(*commands.goto_, { *default_ptr });
+        cost += 1;
+    }
+
+    return cost;
+}
+
 void CompilerContext::compile_break(const SyntaxTree& break_node)
 {
     for(auto it = loop_stack.rbegin(); it != loop_stack.rend(); ++it)
     {
         if(it->break_label)
         {
-            compile_command(*commands.goto_, { it->break_label });
+            compile_command(*commands.goto_, { *it->break_label });
             return;
         }
     }
@@ -510,7 +720,7 @@ void CompilerContext::compile_continue(const SyntaxTree& continue_node)
     {
         if(it->continue_label)
         {
-            compile_command(*commands.goto_, { it->continue_label });
+            compile_command(*commands.goto_, { *it->continue_label });
             return;
         }
     }
@@ -580,6 +790,12 @@ void CompilerContext::compile_mission_end(const SyntaxTree& me_node, bool not_fl
 
 void CompilerContext::compile_condition(const SyntaxTree& node, bool not_flag)
 {
+    auto guard = make_scope_guard([&, prev_statement = this->current_statement] {
+        this->current_statement = prev_statement;
+    });
+
+    this->current_statement = &node;
+
     // also see compile_conditions
     switch(node.type())
     {
@@ -598,7 +814,7 @@ void CompilerContext::compile_condition(const SyntaxTree& node, bool not_flag)
     }
 }
 
-void CompilerContext::compile_conditions(const SyntaxTree& conds_node, const shared_ptr<Label>& else_ptr)
+void CompilerContext::compile_conditions(const SyntaxTree& conds_node, LabelRef else_ptr)
 {
     auto compile_multi_andor = [this](const auto& conds_node, size_t op)
     {
@@ -637,7 +853,7 @@ void CompilerContext::compile_conditions(const SyntaxTree& conds_node, const sha
 auto CompilerContext::get_args(const Command& command, const std::vector<any>& params) -> ArgList
 {
     ArgList args;
-    args.reserve(params.size());
+    args.reserve(params.size() + command.has_optional()); // plus EOAL
 
     for(auto& p : params)
         args.emplace_back(get_arg(p));
@@ -650,7 +866,7 @@ auto CompilerContext::get_args(const Command& command, const SyntaxTree& command
     Expects(command_node.child_count() >= 1); // command_name + [args...]
 
     ArgList args;
-    args.reserve(command_node.child_count() - 1);
+    args.reserve(command_node.child_count() - 1 + command.has_optional()); // plus EOAL
 
     for(auto it = std::next(command_node.begin()); it != command_node.end(); ++it)
         args.emplace_back( get_arg(**it) );
@@ -675,7 +891,7 @@ ArgVariant CompilerContext::get_arg(const any& param)
     else if(auto opt = any_cast<float>(&param))
         return *opt;
     else if(auto opt = any_cast<shared_ptr<Label>>(&param))
-        return std::move(*opt);
+        return arena.add_label(*opt);
     else
         Unreachable(); // implement more on necessity
 }
@@ -706,14 +922,14 @@ ArgVariant CompilerContext::get_arg(const SyntaxTree& arg_node)
             }
             else if(auto opt_var = arg_node.maybe_annotation<shared_ptr<Var>>())
             {
-                return CompiledVar{ std::move(*opt_var), nullopt };
+                return CompiledVar{ arena.add_var(*opt_var), nullopt };
             }
             else if(auto opt_var = arg_node.maybe_annotation<const ArrayAnnotation&>())
             {
                 if(is<shared_ptr<Var>>(opt_var->index))
-                    return CompiledVar { opt_var->base, get<shared_ptr<Var>>(opt_var->index) };
+                    return CompiledVar { arena.add_var(opt_var->base), arena.add_var(get<shared_ptr<Var>>(opt_var->index)) };
                 else
-                    return CompiledVar { opt_var->base, get<int32_t>(opt_var->index) };
+                    return CompiledVar { arena.add_var(opt_var->base), get<int32_t>(opt_var->index) };
             }
             else if(auto opt_label = arg_node.maybe_annotation<shared_ptr<Label>>())
             {
@@ -724,7 +940,7 @@ ArgVariant CompilerContext::get_arg(const SyntaxTree& arg_node)
                     program.error(arg_node, "reference to local label outside of its {} script", sckind_);
                     program.note(*label->script.lock(), "label belongs to this script");
                 }
-                return label;
+                return arena.add_label(std::move(label));
             }
             else if(auto opt_text = arg_node.maybe_annotation<const TextLabelAnnotation&>())
             {
@@ -733,7 +949,7 @@ ArgVariant CompilerContext::get_arg(const SyntaxTree& arg_node)
                     program.warning(arg_node, "text label collides with some variable name");
 
                 auto type = opt_text->is_varlen? CompiledString::Type::StringVar : CompiledString::Type::TextLabel8;
-                return CompiledString{ type, opt_text->preserve_case, opt_text->string };
+                return arena.add_string(type, opt_text->preserve_case, opt_text->string);
             }
             else if(auto opt_umodel = arg_node.maybe_annotation<const ModelAnnotation&>())
             {
@@ -753,11 +969,11 @@ ArgVariant CompilerContext::get_arg(const SyntaxTree& arg_node)
             if(auto opt_text = arg_node.maybe_annotation<const TextLabelAnnotation&>())
             {
                 auto type = opt_text->is_varlen? CompiledString::Type::StringVar : CompiledString::Type::TextLabel8;
-                return CompiledString{ type, opt_text->preserve_case, opt_text->string };
+                return arena.add_string(type, opt_text->preserve_case, opt_text->string);
             }
             else if(auto opt_buffer = arg_node.maybe_annotation<const String128Annotation&>())
             {
-                return CompiledString { CompiledString::Type::String128, false, opt_buffer->string };
+                return arena.add_string(CompiledString::Type::String128, false, opt_buffer->string);
             }
             else
             {
@@ -779,3 +995,58 @@ bool CompilerContext::is_same_var(const ArgVariant& lhs, const ArgVariant& rhs)
     }
     return false;
 }
+
+LabelRef IRArena::make_label(shared_ptr<const Scope> scope, shared_ptr<const Script> script)
+{
+    Expects(this->labels.size() < UINT32_MAX);
+    this->internal_labels.emplace_back(std::move(scope), std::move(script));
+    this->labels.emplace_back(std::addressof(this->internal_labels.back()));
+    return LabelRef { static_cast<uint32_t>(this->labels.size() - 1) };
+}
+
+LabelRef IRArena::add_label(shared_ptr<Label> label)
+{
+    Expects(this->labels.size() < UINT32_MAX);
+    auto it = this->label_ids.emplace(label.get(), static_cast<uint32_t>(this->labels.size())).first;
+    if(it->second == this->labels.size())
+    {
+        this->labels.emplace_back(label.get());
+        this->external_labels.emplace_back(std::move(label));
+    }
+    return LabelRef { it->second };
+}
+
+VarRef IRArena::add_var(shared_ptr<Var> var)
+{
+    Expects(this->vars.size() < UINT32_MAX);
+    auto it = this->var_ids.emplace(var.get(), static_cast<uint32_t>(this->vars.size())).first;
+    if(it->second == this->vars.size())
+        this->vars.emplace_back(std::move(var));
+    return VarRef { it->second };
+}
+
+CompiledString IRArena::add_string(CompiledString::Type type, bool preserve_case, const string_view& string)
+{
+    Expects(this->char_pool.size() + string.size() < UINT32_MAX);
+    auto offset = static_cast<uint32_t>(this->char_pool.size());
+    this->char_pool.insert(this->char_pool.end(), string.begin(), string.end());
+    this->char_pool.push_back('\0');
+    return CompiledString { type, preserve_case, offset, static_cast<uint32_t>(string.size()) };
+}
+
+CompiledHex IRArena::add_hex(const std::vector<uint8_t>& bytes)
+{
+    Expects(this->byte_pool.size() + bytes.size() <= UINT32_MAX);
+    auto offset = static_cast<uint32_t>(this->byte_pool.size());
+    this->byte_pool.insert(this->byte_pool.end(), bytes.begin(), bytes.end());
+    return CompiledHex { offset, static_cast<uint32_t>(bytes.size()) };
+}
+
+CompiledCommand IRArena::add_command(bool not_flag, const Command& command, const ArgVariant* args, size_t count,
+                                     uint32_t source_begin, uint32_t source_end)
+{
+    Expects(this->arg_pool.size() + count <= UINT32_MAX);
+    auto begin = static_cast<uint32_t>(this->arg_pool.size());
+    this->arg_pool.insert(this->arg_pool.end(), args, args + count);
+    return CompiledCommand { not_flag, command, begin, static_cast<uint32_t>(count), source_begin, source_end };
+}
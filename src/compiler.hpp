@@ -10,31 +10,75 @@
 #include <stdinc.h>
 #include "program.hpp"
 
+/// Handle to a label in the `IRArena` of a script.
+struct LabelRef
+{
+    uint32_t id;
+
+    bool operator==(const LabelRef& rhs) const { return this->id == rhs.id; }
+    bool operator!=(const LabelRef& rhs) const { return this->id != rhs.id; }
+};
+
+/// Handle to a variable in the `IRArena` of a script.
+struct VarRef
+{
+    uint32_t id;
+
+    bool operator==(const VarRef& rhs) const { return this->id == rhs.id; }
+    bool operator!=(const VarRef& rhs) const { return this->id != rhs.id; }
+};
+
 /// IR for variable / array.
 struct CompiledVar
 {
-    shared_ptr<Var>                             var;
-    optional<variant<int32_t, shared_ptr<Var>>> index;
+    enum class IndexType : uint8_t
+    {
+        None,       //< Not indexed.
+        Constant,   //< Indexed by the constant `index`.
+        Var,        //< Indexed by the variable of id `index`.
+    };
 
-    explicit CompiledVar(shared_ptr<Var> var, nullopt_t)
-        : var(std::move(var)), index(nullopt)
+    VarRef      var;
+    IndexType   index_type;
+    uint32_t    index;
+
+    explicit CompiledVar(VarRef var, nullopt_t)
+        : var(var), index_type(IndexType::None), index(0)
     {}
 
-    explicit CompiledVar(shared_ptr<Var> var, int32_t index)
-        : var(std::move(var)), index(index)
+    explicit CompiledVar(VarRef var, int32_t index)
+        : var(var), index_type(IndexType::Constant), index(static_cast<uint32_t>(index))
     {}
 
-    explicit CompiledVar(shared_ptr<Var> var, shared_ptr<Var> index)
-        : var(std::move(var)), index(std::move(index))
+    explicit CompiledVar(VarRef var, VarRef index)
+        : var(var), index_type(IndexType::Var), index(index.id)
     {}
 
+    /// Gets the constant index of this array, if indexed by a constant.
+    optional<int32_t> constant_index() const
+    {
+        if(index_type == IndexType::Constant)
+            return static_cast<int32_t>(index);
+        return nullopt;
+    }
+
+    /// Gets the index variable of this array, if indexed by a variable.
+    optional<VarRef> var_index() const
+    {
+        if(index_type == IndexType::Var)
+            return VarRef { index };
+        return nullopt;
+    }
+
     bool operator==(const CompiledVar& rhs) const
     {
-        return this->var == rhs.var && this->index == rhs.index;
+        return this->var == rhs.var && this->index_type == rhs.index_type && this->index == rhs.index;
     }
 };
 
 /// IR for strings, no matter if it's a fixed size (8/16/128 bytes) or var length.
+///
+/// The characters are stored in the `IRArena` of the script.
 struct CompiledString
 {
     enum class Type : uint8_t
@@ -47,18 +91,30 @@ struct CompiledString
 
     Type        type;
     bool        preserve_case;
-    std::string storage;
+    uint32_t    offset;     //< Offset of the null-terminated characters in the arena.
+    uint32_t    size;       //< Number of characters, not including the null terminator.
 };
 
 /// IR for a single argument of a command.
-using ArgVariant = variant<EOAL, int8_t, int16_t, int32_t, float, shared_ptr<Label>, CompiledVar, CompiledString>;
+using ArgVariant = variant<EOAL, int8_t, int16_t, int32_t, float, LabelRef, CompiledVar, CompiledString>;
 
 /// IR for a single command plus its arguments.
+///
+/// The arguments are stored in the `IRArena` of the script.
 struct CompiledCommand
 {
     bool                    not_flag;
     const Command&          command;
-    std::vector<ArgVariant> args;
+    uint32_t                args_begin;         //< Index of the first argument in the arena.
+    uint32_t                args_count;         //< Number of arguments.
+    uint32_t                source_begin = 0;   //< Source text of the statement this command was compiled from,
+    uint32_t                source_end = 0;     //< or an empty range if none.
+
+    /// Gets the source text this command was compiled from, `script` being the script it belongs to.
+    SourceRange source(const Script& script) const
+    {
+        return SourceRange { script, source_begin, source_end };
+    }
 };
 
 /// IR for label **definitions**.
@@ -66,7 +122,7 @@ struct CompiledCommand
 /// This is just a helper to find out where the labels are.
 struct CompiledLabelDef
 {
-    shared_ptr<Label> label;
+    LabelRef label;
 
     size_t compiled_size() const
     {
@@ -75,16 +131,98 @@ struct CompiledLabelDef
 };
 
 /// IR for HEX data.
+///
+/// The bytes are stored in the `IRArena` of the script.
 struct CompiledHex
 {
-    std::vector<uint8_t> data;
+    uint32_t offset;    //< Offset of the bytes in the arena.
+    uint32_t size;      //< Number of bytes.
 
     size_t compiled_size() const
     {
-        return data.size();
+        return size;
     }
 };
 
+/// Storage for the IR of a single script.
+///
+/// Arguments, strings, HEX data and labels are stored contiguously in here, and the pseudo-instructions
+/// refer to them by 32-bit handles. Labels and variables from outside the arena (e.g. from the symbol table)
+/// are kept alive by it, a single time no matter how many times they are referenced.
+class IRArena
+{
+public:
+    /// Contiguous range of objects in the arena.
+    template<typename T>
+    class Span
+    {
+    public:
+        explicit Span(T* first, size_t count) : first(first), count(count) {}
+
+        T* begin() const                    { return first; }
+        T* end() const                      { return first + count; }
+        size_t size() const                 { return count; }
+        T& operator[](size_t i) const       { assert(i < count); return first[i]; }
+
+    private:
+        T*      first;
+        size_t  count;
+    };
+
+public:
+    /// Creates a label which belongs to this arena.
+    LabelRef make_label(shared_ptr<const Scope> scope, shared_ptr<const Script> script);
+
+    /// Gets the handle of a label from outside the arena. The same label always gets the same handle.
+    LabelRef add_label(shared_ptr<Label> label);
+
+    /// Gets the handle of a variable. The same variable always gets the same handle.
+    VarRef add_var(shared_ptr<Var> var);
+
+    /// Stores a string.
+    CompiledString add_string(CompiledString::Type type, bool preserve_case, const string_view& string);
+
+    /// Stores HEX data.
+    CompiledHex add_hex(const std::vector<uint8_t>& bytes);
+
+    /// Stores the arguments of a command.
+    CompiledCommand add_command(bool not_flag, const Command& command, const ArgVariant* args, size_t count,
+                                uint32_t source_begin, uint32_t source_end);
+
+    const Label& label(LabelRef ref) const          { return *this->labels[ref.id]; }
+    Label& label(LabelRef ref)                      { return *this->labels[ref.id]; }
+
+    const Var& var(VarRef ref) const                { return *this->vars[ref.id]; }
+
+    /// Gets the null-terminated characters of `str`.
+    const char* chars(const CompiledString& str) const    { return std::addressof(this->char_pool[str.offset]); }
+
+    const uint8_t* bytes(const CompiledHex& hex) const  { return this->byte_pool.data() + hex.offset; }
+
+    Span<const ArgVariant> args(const CompiledCommand& ccmd) const
+    {
+        return Span<const ArgVariant>(this->arg_pool.data() + ccmd.args_begin, ccmd.args_count);
+    }
+
+    Span<ArgVariant> args(const CompiledCommand& ccmd)
+    {
+        return Span<ArgVariant>(this->arg_pool.data() + ccmd.args_begin, ccmd.args_count);
+    }
+
+private:
+    std::vector<ArgVariant>                     arg_pool;
+    std::vector<char>                           char_pool;
+    std::vector<uint8_t>                        byte_pool;
+
+    std::vector<Label*>                         labels;             //< Labels by handle.
+    std::deque<Label>                           internal_labels;    //< Storage for the labels of `make_label`.
+    std::vector<shared_ptr<Label>>              external_labels;    //< Keeps the labels of `add_label` alive.
+    std::unordered_map<const Label*, uint32_t>  label_ids;
+
+    std::vector<shared_ptr<Var>>                vars;               //< Variables by handle.
+    std::unordered_map<const Var*, uint32_t>    var_ids;
+};
+
 // IR for SCM header
 struct CompiledScmHeader
 {
@@ -138,12 +276,12 @@ struct CompiledData
         : data(std::move(x))
     {}
 
-    CompiledData(std::vector<uint8_t> x)
-        : data(CompiledHex { std::move(x) })
+    CompiledData(CompiledHex x)
+        : data(std::move(x))
     {}
 
-    CompiledData(shared_ptr<Label> x)
-        : data(CompiledLabelDef{ std::move(x) })
+    CompiledData(LabelRef x)
+        : data(CompiledLabelDef{ x })
     {}
 };
 
@@ -153,15 +291,15 @@ class CompilerContext
 private:
     struct LoopInfo
     {
-        shared_ptr<Label> continue_label;   //< Where a CONTINUE should jump into (may be nullptr).
-        shared_ptr<Label> break_label;      //< Where a BREAK should jump into
+        optional<LabelRef> continue_label;  //< Where a CONTINUE should jump into (may be nullopt).
+        optional<LabelRef> break_label;     //< Where a BREAK should jump into
     };
 
     // Helpers
     shared_ptr<Scope>              current_scope;
-    std::vector<shared_ptr<Label>> internal_labels;
     std::vector<LoopInfo>          loop_stack;
-    shared_ptr<Label>              label_skip_cutscene_end;
+    optional<LabelRef>             label_skip_cutscene_end;
+    const SyntaxTree*              current_statement = nullptr;
 
     // Inputs
     ProgramContext&                 program;
@@ -169,6 +307,7 @@ private:
     
     // Output
     std::vector<CompiledData>       compiled;
+    IRArena                         arena;
 
 public:
     // Inputs
@@ -197,14 +336,20 @@ public:
     std::vector<CompiledData>& get_data() &            { return this->compiled; }
     std::vector<CompiledData> get_data() &&            { return std::move(this->compiled); }
 
+    /// Gets the storage of the result of `compile`.
+    const IRArena& get_arena() const&                  { return this->arena; }
+    IRArena& get_arena() &                             { return this->arena; }
+    IRArena get_arena() &&                             { return std::move(this->arena); }
+
 private:
 
-    using ArgList = std::vector<ArgVariant>;
+    using ArgList = small_vector<ArgVariant, 8>;
 
     struct Case;
+    struct CaseRange;
     struct LoopInfo;
 
-    shared_ptr<Label> make_internal_label();
+    LabelRef make_internal_label();
 
     void compile_statements(const SyntaxTree& parent, size_t from_id, size_t to_id_including);
 
@@ -214,7 +359,7 @@ private:
 
     void compile_label(const SyntaxTree& label_node);
 
-    void compile_label(shared_ptr<Label> label_ptr);
+    void compile_label(LabelRef label);
 
     void compile_command(const Command& command, ArgList args, bool not_flag = false);
 
@@ -232,9 +377,24 @@ private:
 
     // \warning mutates `cases`.
     // \warning expects no repeated Cases.
-    void compile_switch_withop(const SyntaxTree& swnode, std::vector<Case>& cases, shared_ptr<Label> break_ptr);
+    void compile_switch_withop(const SyntaxTree& swnode, std::vector<Case>& cases, LabelRef break_ptr);
 
-    void compile_switch_ifchain(const SyntaxTree& swnode, std::vector<Case>& cases, shared_ptr<Label> break_ptr);
+    void compile_switch_ifchain(const SyntaxTree& swnode, std::vector<Case>& cases, LabelRef break_ptr);
+
+    // \warning mutates `cases`.
+    // \warning expects no repeated Cases, and `Case::is_var_gt_int` available on all non-default Cases.
+    void compile_switch_bsearch(const SyntaxTree& swnode, std::vector<Case>& cases, LabelRef break_ptr);
+
+    // Searches `ranges[begin, end)` knowing the variable is within `[min, max]`. Compiles nothing if `dry_run`.
+    // \returns the number of commands executed on the longest path of the search.
+    size_t compile_switch_bsearch(const SyntaxTree& swnode, const std::vector<CaseRange>& ranges, size_t begin, size_t end,
+                                  int64_t min, int64_t max, optional<LabelRef> default_ptr, bool dry_run);
+
+    // \returns the number of commands executed on the longest path of `compile_switch_ifchain`.
+    static size_t switch_ifchain_cost(const std::vector<Case>& cases);
+
+    // Groups the non-default `cases` into sorted ranges of contiguous values with the same body.
+    static std::vector<CaseRange> make_case_ranges(const std::vector<Case>& cases);
 
     void compile_break(const SyntaxTree& break_node);
 
@@ -248,7 +408,7 @@ private:
 
     void compile_condition(const SyntaxTree& node, bool not_flag = false);
 
-    void compile_conditions(const SyntaxTree& conds_node, const shared_ptr<Label>& else_ptr);
+    void compile_conditions(const SyntaxTree& conds_node, LabelRef else_ptr);
 
     void compile_dump(const SyntaxTree& node);
 
@@ -271,8 +431,9 @@ private:
     struct Case
     {
         optional<int32_t>            value;
-        shared_ptr<Label>            target;
+        optional<LabelRef>           target;
         optional<const Command*>     is_var_eq_int;
+        const Command*               is_var_gt_int = nullptr;
         size_t                       first_statement_id = SIZE_MAX;
         size_t                       last_statement_id = SIZE_MAX;
 
@@ -298,4 +459,11 @@ private:
         }
     };
 
+    struct CaseRange
+    {
+        int32_t                      min;       //< Lowest value of the range.
+        int32_t                      max;       //< Highest value of the range.
+        const Case*                  first;     //< Case of the lowest value, with the body of all the range.
+    };
+
 };
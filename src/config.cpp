@@ -99,7 +99,7 @@ static void parse_enum_node(transparent_map<std::string, shared_ptr<Enum>>& enum
     auto eit = enums.find(enum_name_attrib->value());
     if(eit == enums.end())
     {
-        auto enum_ptr = std::make_shared<Enum>(Enum { {}, is_global });
+        auto enum_ptr = std::make_shared<Enum>(insensitive_map<std::string, int32_t>(), is_global);
         eit = enums.emplace(enum_name_attrib->value(), std::move(enum_ptr)).first;
     }
     else
@@ -107,7 +107,7 @@ static void parse_enum_node(transparent_map<std::string, shared_ptr<Enum>>& enum
         assert(is_global == eit->second->is_global);
     }
 
-    insensitive_map<std::string, int32_t>& constant_map = eit->second->values;
+    Enum& enum_ = *eit->second;
     int32_t current_value = 0;
 
     for(auto value_node = enum_node->first_node(); value_node; value_node = value_node->next_sibling())
@@ -123,7 +123,7 @@ static void parse_enum_node(transparent_map<std::string, shared_ptr<Enum>>& enum
         if(value_value_attrib)
             current_value = xml_stoi(value_value_attrib->value());
 
-        constant_map.emplace(value_name_attrib->value(), current_value);
+        enum_.defer(value_name_attrib->value(), current_value);
 
         ++current_value;
     }
@@ -270,7 +270,7 @@ static void
     }
 }
 
-Commands Commands::from_xml(const std::string& config_name, const std::vector<fs::path>& xml_list)
+Commands Commands::from_xml(const std::string& config_name, const std::vector<fs::path>& xml_list, bool builtin)
 {
     using namespace rapidxml;
 
@@ -294,16 +294,15 @@ Commands Commands::from_xml(const std::string& config_name, const std::vector<fs
     transparent_map<std::string, shared_ptr<Enum>>              enums;
 
     // fundamental enums
-    enums.emplace("MODEL", std::make_shared<Enum>(Enum { {}, false, }));
-    enums.emplace("DEFAULTMODEL", std::make_shared<Enum>(Enum { {}, false, }));
-    enums.emplace("SCRIPTSTREAM", std::make_shared<Enum>(Enum { {}, false, }));
+    enums.emplace("MODEL", std::make_shared<Enum>(insensitive_map<std::string, int32_t>(), false));
+    enums.emplace("DEFAULTMODEL", std::make_shared<Enum>(insensitive_map<std::string, int32_t>(), false));
+    enums.emplace("SCRIPTSTREAM", std::make_shared<Enum>(insensitive_map<std::string, int32_t>(), false));
 
-    auto xml_parse = [](const fs::path& path) -> XmlData
+    auto xml_parse = [](const fs::path& path, optional<std::string> opt_buffer) -> XmlData
     {
         fs::path full_xml_path(path);
         try
         {
-            auto opt_buffer = read_file_utf8(full_xml_path);
             if(opt_buffer == nullopt)
                 throw ConfigError("failed to read xml {}: {}", full_xml_path.generic_u8string(), "could not open file for reading");
 
@@ -322,15 +321,24 @@ Commands Commands::from_xml(const std::string& config_name, const std::vector<fs
         }
     };
 
-    for(auto& xml_path : xml_list)
+    auto xml_load = [&](const fs::path& xml_path) -> XmlData
     {
         fs::path path;
+        optional<std::string> opt_buffer;
         {
             if(!xml_path.is_absolute())
             {
                 auto begin = xml_path.begin();
                 if(begin != xml_path.end() && (*begin == "." || *begin == ".."))
                     path = xml_path;
+                else if(builtin)
+                {
+                    path = fs::path(config_name) / xml_path;
+                    if(auto opt_data = find_builtin_config(config_name, xml_path.generic_u8string()))
+                        opt_buffer.emplace(opt_data->data(), opt_data->size());
+                    else
+                        throw ConfigError("failed to read xml {}: {}", path.generic_u8string(), "not built into the executable");
+                }
                 else
                     path = config_path() / config_name / xml_path;
             }
@@ -340,7 +348,21 @@ Commands Commands::from_xml(const std::string& config_name, const std::vector<fs
             }
         }
 
-        xml_vector.emplace_back(xml_parse(path));
+        if(opt_buffer == nullopt)
+            opt_buffer = read_file_utf8(path);
+
+        return xml_parse(path, std::move(opt_buffer));
+    };
+
+    // The files are read and parsed in parallel, but their sections are merged serially (and in order) below.
+    std::vector<std::future<XmlData>> xml_futures;
+    xml_futures.reserve(xml_list.size());
+    for(auto& xml_path : xml_list)
+        xml_futures.emplace_back(std::async(std::launch::async, xml_load, std::cref(xml_path)));
+
+    for(auto& xml_future : xml_futures)
+    {
+        xml_vector.emplace_back(xml_future.get());
 
         if(xml_node<>* root_node = xml_vector.back().doc->first_node("GTA3Script"))
         {
@@ -409,3 +431,360 @@ Commands Commands::from_xml(const std::string& config_name, const std::vector<fs
 
     return Commands { std::move(commands), std::move(alternators), std::move(entities), std::move(enums) };
 }
+
+optional<Commands> Commands::from_builtin(const std::string& config_name, const std::vector<fs::path>& xml_list)
+{
+    std::string xml_list_name;
+    for(auto& xml_path : xml_list)
+    {
+        if(!xml_list_name.empty()) xml_list_name.push_back(';');
+        xml_list_name += xml_path.generic_u8string();
+    }
+
+    for(auto table_it = GTA3SC_BUILTIN_COMMANDS; *table_it != nullptr; ++table_it)
+    {
+        const BuiltinCommands& table = **table_it;
+
+        if(!iequal_to()(config_name, table.config_name))
+            continue;
+
+        auto list_it = std::find(table.xml_lists, table.xml_lists + table.num_xml_lists, xml_list_name);
+        if(list_it == table.xml_lists + table.num_xml_lists)
+            return nullopt;
+
+        const uint8_t list_mask = uint8_t(1 << (list_it - table.xml_lists));
+
+        transparent_set<Command>                                    commands;
+        insensitive_map<std::string, std::vector<const Command*>>   alternators;
+        transparent_map<std::string, EntityType>                    entities;
+        transparent_map<std::string, shared_ptr<Enum>>              enums;
+
+        std::vector<shared_ptr<Enum>> enum_slots(table.num_enum_slots);
+        std::vector<const Command*> command_ptrs(table.num_commands);
+
+        for(size_t i = 0; i < table.num_enums; ++i)
+        {
+            auto& builtin_enum = table.enums[i];
+            if(builtin_enum.lists & list_mask)
+            {
+                auto enum_ptr = std::make_shared<Enum>(insensitive_map<std::string, int32_t>(), builtin_enum.is_global);
+                for(size_t k = 0; k < builtin_enum.num_constants; ++k)
+                    enum_ptr->defer(builtin_enum.constants[k].name, builtin_enum.constants[k].value);
+
+                enum_slots[builtin_enum.slot] = enum_ptr;
+                enums.emplace(builtin_enum.name, std::move(enum_ptr));
+            }
+        }
+
+        for(size_t i = 0; i < table.num_entities; ++i)
+        {
+            if(table.entities[i].lists & list_mask)
+                entities.emplace(table.entities[i].name, table.entities[i].type);
+        }
+
+        for(size_t i = 0; i < table.num_commands; ++i)
+        {
+            auto& builtin_command = table.commands[i];
+            if(!(builtin_command.lists & list_mask))
+                continue;
+
+            decltype(Command::args) args;
+            args.reserve(builtin_command.num_args);
+
+            for(size_t k = 0; k < builtin_command.num_args; ++k)
+            {
+                auto& builtin_arg = builtin_command.args[k];
+
+                Command::Arg arg;
+                arg.type = builtin_arg.type;
+                arg.optional = builtin_arg.optional;
+                arg.is_output = builtin_arg.is_output;
+                arg.is_ref = builtin_arg.is_ref;
+                arg.allow_constant = builtin_arg.allow_constant;
+                arg.allow_global_var = builtin_arg.allow_global_var;
+                arg.allow_local_var = builtin_arg.allow_local_var;
+                arg.allow_text_label = builtin_arg.allow_text_label;
+                arg.allow_pointer = builtin_arg.allow_pointer;
+                arg.preserve_case = builtin_arg.preserve_case;
+                arg.entity_type = builtin_arg.entity_type;
+
+                if(builtin_arg.enum_slot >= 0)
+                {
+                    assert(enum_slots[builtin_arg.enum_slot] != nullptr);
+                    arg.enums.emplace_back(enum_slots[builtin_arg.enum_slot]);
+                }
+
+                args.emplace_back(std::move(arg));
+            }
+
+            auto it = commands.insert(Command {
+                builtin_command.supported,
+                builtin_command.internal,
+                builtin_command.extension,
+                builtin_command.id >= 0? optional<uint16_t>(uint16_t(builtin_command.id)) : nullopt,
+                builtin_command.hash >= 0? optional<uint32_t>(uint32_t(builtin_command.hash)) : nullopt,
+                std::move(args),
+                builtin_command.name,
+            }).first;
+
+            command_ptrs[i] = std::addressof(*it);
+        }
+
+        for(size_t i = 0; i < table.num_alternators; ++i)
+        {
+            auto& builtin_alternator = table.alternators[i];
+            if(!(builtin_alternator.lists & list_mask))
+                continue;
+
+            std::vector<const Command*> alternatives;
+            alternatives.reserve(builtin_alternator.num_commands);
+            for(size_t k = 0; k < builtin_alternator.num_commands; ++k)
+            {
+                assert(command_ptrs[builtin_alternator.commands[k]] != nullptr);
+                alternatives.emplace_back(command_ptrs[builtin_alternator.commands[k]]);
+            }
+
+            alternators.emplace(builtin_alternator.name, std::move(alternatives));
+        }
+
+        return Commands { std::move(commands), std::move(alternators), std::move(entities), std::move(enums) };
+    }
+
+    return nullopt;
+}
+
+/// Entries of a `BuiltinCommands` table, each with the mask of XML lists it's part of.
+template<typename T>
+struct BuiltinEntries
+{
+    std::vector<std::pair<uint8_t, T>>  entries;
+    std::map<T, uint32_t>               indices;
+
+    /// Adds `value` into the XML list `list`, unless an equal value is in another list already.
+    ///
+    /// \returns the index of the entry.
+    uint32_t add(T value, size_t list)
+    {
+        auto it = this->indices.emplace(std::move(value), uint32_t(this->entries.size())).first;
+        if(it->second == this->entries.size())
+            this->entries.emplace_back(0, it->first);
+        this->entries[it->second].first |= uint8_t(1 << list);
+        return it->second;
+    }
+};
+
+static std::string cpp_string_literal(const string_view& string)
+{
+    std::string result = "\"";
+    for(char c : string)
+    {
+        if(isalnum(static_cast<unsigned char>(c)) || c == '_' || c == ' ' || c == '.' || c == ';' || c == '-')
+            result.push_back(c);
+        else
+            result += fmt::format("\\{:03o}", static_cast<unsigned char>(c));
+    }
+    result.push_back('"');
+    return result;
+}
+
+static const char* cpp_bool(bool value)
+{
+    return value? "true" : "false";
+}
+
+std::string Commands::to_builtin_source(const std::string& config_name, const std::string& symbol,
+                                        const std::vector<std::vector<fs::path>>& xml_lists)
+{
+    using EnumEntry       = std::tuple<uint16_t, std::string, bool, std::vector<std::string>>; // slot, name, is_global, constants
+    using CommandEntry    = std::tuple<std::string, std::string, std::vector<std::string>>;    // name, fields, args
+    using AlternatorEntry = std::tuple<std::string, std::vector<uint32_t>>;                    // name, commands
+    using EntityEntry     = std::tuple<std::string, EntityType>;                               // name, type
+
+    Expects(xml_lists.size() <= 8);
+
+    std::vector<std::string>            enum_slots;
+    std::vector<std::string>            xml_list_names;
+    BuiltinEntries<EnumEntry>           enum_entries;
+    BuiltinEntries<CommandEntry>        command_entries;
+    BuiltinEntries<AlternatorEntry>     alternator_entries;
+    BuiltinEntries<EntityEntry>         entity_entries;
+
+    for(size_t list = 0; list < xml_lists.size(); ++list)
+    {
+        Commands commands = Commands::from_xml(config_name, xml_lists[list], true);
+
+        std::string xml_list_name;
+        for(auto& xml_path : xml_lists[list])
+        {
+            if(!xml_list_name.empty()) xml_list_name.push_back(';');
+            xml_list_name += xml_path.generic_u8string();
+        }
+        xml_list_names.emplace_back(std::move(xml_list_name));
+
+        std::map<const Enum*, uint16_t> slot_by_enum;
+        for(auto& enum_pair : commands.enums)
+        {
+            auto slot_it = std::find(enum_slots.begin(), enum_slots.end(), enum_pair.first);
+            if(slot_it == enum_slots.end())
+                slot_it = enum_slots.insert(enum_slots.end(), enum_pair.first);
+
+            auto slot = uint16_t(slot_it - enum_slots.begin());
+            slot_by_enum.emplace(enum_pair.second.get(), slot);
+
+            std::vector<std::string> constants;
+            for(auto& value_pair : static_cast<const Enum&>(*enum_pair.second).values())
+                constants.emplace_back(fmt::format("{{ {}, {} }}", cpp_string_literal(value_pair.first), value_pair.second));
+
+            enum_entries.add(EnumEntry { slot, enum_pair.first, enum_pair.second->is_global, std::move(constants) }, list);
+        }
+
+        std::map<const Command*, uint32_t> index_by_command;
+        for(auto& command : commands.commands)
+        {
+            std::vector<std::string> args;
+            for(auto& arg : command.args)
+            {
+                assert(arg.enums.size() <= 1);
+                int32_t enum_slot = arg.enums.empty()? -1 : slot_by_enum.at(arg.enums.front().get());
+                args.emplace_back(fmt::format("{{ static_cast<ArgType>({}), {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {} }}",
+                                              static_cast<int>(arg.type), cpp_bool(arg.optional), cpp_bool(arg.is_output),
+                                              cpp_bool(arg.is_ref), cpp_bool(arg.allow_constant), cpp_bool(arg.allow_global_var),
+                                              cpp_bool(arg.allow_local_var), cpp_bool(arg.allow_text_label), cpp_bool(arg.allow_pointer),
+                                              cpp_bool(arg.preserve_case), arg.entity_type, enum_slot));
+            }
+
+            auto fields = fmt::format("{}, {}, {}, {}, {}", cpp_bool(command.supported), cpp_bool(command.internal),
+                                      cpp_bool(command.extension), command.id? int32_t(*command.id) : -1,
+                                      command.hash? int64_t(*command.hash) : -1);
+
+            auto index = command_entries.add(CommandEntry { command.name, std::move(fields), std::move(args) }, list);
+            index_by_command.emplace(std::addressof(command), index);
+        }
+
+        for(auto& alternator_pair : commands.alternators)
+        {
+            std::vector<uint32_t> alternatives;
+            for(auto& command : alternator_pair.second)
+                alternatives.emplace_back(index_by_command.at(command));
+            alternator_entries.add(AlternatorEntry { alternator_pair.first, std::move(alternatives) }, list);
+        }
+
+        for(auto& entity_pair : commands.entities)
+            entity_entries.add(EntityEntry { entity_pair.first, entity_pair.second }, list);
+    }
+
+    std::string source = fmt::format("///\n"
+                                     "/// This file is generated by `gta3sc emit-builtin-commands --builtin-config={}`.\n"
+                                     "/// See GTA3SC_BUILTIN_CONFIG in CMakeLists.txt for details.\n"
+                                     "///\n"
+                                     "#include <stdinc.h>\n"
+                                     "#include \"commands.hpp\"\n\n"
+                                     "namespace\n{{\n", config_name);
+
+    // Emits the array `name` with `count` elements, calling `emit_element(i)` for each. Arrays cannot be empty in C++,
+    // thus the returned expression to refer to the array is `nullptr` in such a case.
+    auto emit_array = [&](const char* type, const char* name, size_t count, auto emit_element) -> std::string
+    {
+        if(count == 0)
+            return "nullptr";
+
+        source += fmt::format("constexpr {} {}[] = {{\n", type, name);
+        for(size_t i = 0; i < count; ++i)
+        {
+            source += "    ";
+            emit_element(i);
+            source += ",\n";
+        }
+        source += "};\n\n";
+        return name;
+    };
+
+    std::vector<std::string> constants;
+    std::vector<size_t> constants_offset;
+    for(auto& entry : enum_entries.entries)
+    {
+        constants_offset.emplace_back(constants.size());
+        constants.insert(constants.end(), std::get<3>(entry.second).begin(), std::get<3>(entry.second).end());
+    }
+
+    std::vector<std::string> args;
+    std::vector<size_t> args_offset;
+    for(auto& entry : command_entries.entries)
+    {
+        args_offset.emplace_back(args.size());
+        args.insert(args.end(), std::get<2>(entry.second).begin(), std::get<2>(entry.second).end());
+    }
+
+    std::vector<uint32_t> alternatives;
+    std::vector<size_t> alternatives_offset;
+    for(auto& entry : alternator_entries.entries)
+    {
+        alternatives_offset.emplace_back(alternatives.size());
+        alternatives.insert(alternatives.end(), std::get<1>(entry.second).begin(), std::get<1>(entry.second).end());
+    }
+
+    auto constants_array = emit_array("BuiltinCommands::Constant", "constants", constants.size(), [&](size_t i) {
+        source += constants[i];
+    });
+
+    auto enums_array = emit_array("BuiltinCommands::Enum", "enums", enum_entries.entries.size(), [&](size_t i) {
+        auto& entry = enum_entries.entries[i];
+        auto num_constants = std::get<3>(entry.second).size();
+        source += fmt::format("{{ {}, {}, {}, {}, {}, {} }}", entry.first, std::get<0>(entry.second),
+                              cpp_string_literal(std::get<1>(entry.second)), cpp_bool(std::get<2>(entry.second)),
+                              num_constants? fmt::format("{} + {}", constants_array, constants_offset[i]) : "nullptr",
+                              num_constants);
+    });
+
+    auto args_array = emit_array("BuiltinCommands::Arg", "args", args.size(), [&](size_t i) {
+        source += args[i];
+    });
+
+    auto commands_array = emit_array("BuiltinCommands::Command", "commands", command_entries.entries.size(), [&](size_t i) {
+        auto& entry = command_entries.entries[i];
+        auto num_args = std::get<2>(entry.second).size();
+        source += fmt::format("{{ {}, {}, {}, {}, {} }}", entry.first, cpp_string_literal(std::get<0>(entry.second)),
+                              std::get<1>(entry.second),
+                              num_args? fmt::format("{} + {}", args_array, args_offset[i]) : "nullptr",
+                              num_args);
+    });
+
+    auto alternatives_array = emit_array("uint32_t", "alternatives", alternatives.size(), [&](size_t i) {
+        source += std::to_string(alternatives[i]);
+    });
+
+    auto alternators_array = emit_array("BuiltinCommands::Alternator", "alternators", alternator_entries.entries.size(), [&](size_t i) {
+        auto& entry = alternator_entries.entries[i];
+        auto num_alternatives = std::get<1>(entry.second).size();
+        source += fmt::format("{{ {}, {}, {}, {} }}", entry.first, cpp_string_literal(std::get<0>(entry.second)),
+                              num_alternatives? fmt::format("{} + {}", alternatives_array, alternatives_offset[i]) : "nullptr",
+                              num_alternatives);
+    });
+
+    auto entities_array = emit_array("BuiltinCommands::Entity", "entities", entity_entries.entries.size(), [&](size_t i) {
+        auto& entry = entity_entries.entries[i];
+        source += fmt::format("{{ {}, {}, {} }}", entry.first, cpp_string_literal(std::get<0>(entry.second)),
+                              std::get<1>(entry.second));
+    });
+
+    auto xml_lists_array = emit_array("const char*", "xml_lists", xml_list_names.size(), [&](size_t i) {
+        source += cpp_string_literal(xml_list_names[i]);
+    });
+
+    source += "}\n\n";
+    source += fmt::format("extern const BuiltinCommands {} = {{\n"
+                          "    {}, {}, {}, {},\n"
+                          "    {}, {},\n"
+                          "    {}, {},\n"
+                          "    {}, {},\n"
+                          "    {}, {},\n"
+                          "}};\n",
+                          symbol,
+                          cpp_string_literal(config_name), xml_lists_array, xml_list_names.size(), enum_slots.size(),
+                          enums_array, enum_entries.entries.size(),
+                          commands_array, command_entries.entries.size(),
+                          alternators_array, alternator_entries.entries.size(),
+                          entities_array, entity_entries.entries.size());
+
+    return source;
+}
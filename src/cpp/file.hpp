@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include <cstdio>
 #include <string>
 #include "optional.hpp"
@@ -42,6 +43,14 @@ inline bool write_file(FILE* f, size_t offset, const void* data, size_t size)
     return (fwrite(data, 1, size, f) == size);
 }
 
+/// Gets the memory of the `size` bytes at `offset` of a file, to be written into directly.
+///
+/// \returns `nullptr` if the file cannot be written this way, in which case `write_file` must be used.
+inline void* file_region(FILE*, size_t offset, size_t size)
+{
+    return nullptr;
+}
+
 inline bool write_file(const fs::path& path, const void* data, size_t size)
 {
     if(auto f = u8fopen(path, "wb"))
@@ -129,3 +138,119 @@ inline bool write_file(std::vector<uint8_t>& vec, size_t offset, const void* dat
     std::memcpy(vec.data() + offset, data, size);
     return true;
 }
+
+inline void* file_region(std::vector<uint8_t>& vec, size_t offset, size_t size)
+{
+    if(vec.size() < offset + size)
+        vec.resize(offset + size);
+    return vec.data() + offset;
+}
+
+//
+// writing files through a memory mapping
+//
+
+/// A file open for writing, which gets memory mapped once its space is allocated.
+///
+/// Falls back to the regular file operations when the file cannot be mapped (e.g. it is not a regular file).
+struct MappedFile
+{
+    FILE*   file = nullptr;
+    void*   data = nullptr;     //< Mapped memory, or `nullptr` if not mapped.
+    size_t  size = 0;           //< Size of the mapped memory.
+
+    std::atomic<size_t> written_end { 0 }; //< Offset past the highest byte written into the mapped memory.
+
+    MappedFile() = default;
+
+    explicit MappedFile(FILE* file) :
+        file(file)
+    {}
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        this->close();
+    }
+
+    void close()
+    {
+        if(this->data)
+            unmap_file(this->data, this->size);
+        if(this->file)
+            fclose(this->file);
+        this->data = nullptr;
+        this->file = nullptr;
+    }
+
+    explicit operator bool() const
+    {
+        return this->file != nullptr;
+    }
+
+    /// Records that the mapped memory up to `end` has been written.
+    void mark_written(size_t end)
+    {
+        size_t written = this->written_end.load();
+        while(written < end && !this->written_end.compare_exchange_weak(written, end))
+        {
+        }
+    }
+};
+
+inline bool allocate_file_space(MappedFile& mf, size_t size)
+{
+    if(!allocate_file_space(mf.file, size))
+        return false;
+
+    mf.data = map_file(mf.file, size);
+    mf.size = mf.data? size : 0;
+    return true;
+}
+
+/// \returns the offset past the highest byte written, like the position of a file written sequentially.
+inline size_t file_tell(MappedFile& mf)
+{
+    return mf.data? mf.written_end.load() : file_tell(mf.file);
+}
+
+/// Whether disjoint regions of the file may be written by several threads at the same time.
+inline bool can_write_concurrently(const MappedFile& mf)
+{
+    return mf.data != nullptr;
+}
+
+inline bool can_write_concurrently(FILE*)
+{
+    return false;
+}
+
+inline bool can_write_concurrently(const std::vector<uint8_t>&)
+{
+    return false;
+}
+
+inline bool write_file(MappedFile& mf, size_t offset, const void* data, size_t size)
+{
+    if(mf.data == nullptr)
+        return write_file(mf.file, offset, data, size);
+
+    if(offset + size > mf.size)
+        return false;
+
+    std::memcpy(static_cast<uint8_t*>(mf.data) + offset, data, size);
+    mf.mark_written(offset + size);
+    return true;
+}
+
+/// The region is considered written as soon as it is returned.
+inline void* file_region(MappedFile& mf, size_t offset, size_t size)
+{
+    if(mf.data == nullptr || offset + size > mf.size)
+        return nullptr;
+
+    mf.mark_written(offset + size);
+    return static_cast<uint8_t*>(mf.data) + offset;
+}
@@ -44,3 +44,19 @@ struct iequal_to
         return strncasecmp(left.data(), right.data(), left.size()) == 0;
     }
 };
+
+/// std::hash<string_view> but case insensitive (ASCII only, like strcasecmp)
+struct ihash
+{
+    size_t operator()(const string_view& string) const
+    {
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        for(char c : string)
+        {
+            hash ^= static_cast<uint8_t>((c >= 'a' && c <= 'z')? c - ('a' - 'A') : c);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+};
@@ -0,0 +1,672 @@
+#include <stdinc.h>
+#include "dataflow.hpp"
+#include "codegen.hpp"
+#include "commands.hpp"
+#include "program.hpp"
+
+bool ControlFlowGraph::is_local_jump(const Command& command, const Commands& commands)
+{
+    return commands.equal(command, commands.goto_)
+        || commands.equal(command, commands.goto_if_false)
+        || commands.equal(command, commands.switch_start)
+        || commands.equal(command, commands.switch_continued);
+}
+
+auto ControlFlowGraph::find_entry_labels(const std::vector<CodeGenerator>& gens, ProgramContext& program) -> std::unordered_set<const Label*>
+{
+    std::unordered_set<const Label*> entry_labels;
+
+    for(auto& gen : gens)
+    {
+        for(auto& data : gen.ir())
+        {
+            if(!is<CompiledCommand>(data.data))
+                continue;
+
+            auto& ccmd = get<CompiledCommand>(data.data);
+            const bool local_jump = is_local_jump(ccmd.command, program.commands);
+
+            for(auto& arg : gen.arena().args(ccmd))
+            {
+                if(is<LabelRef>(arg))
+                {
+                    auto& label = gen.arena().label(get<LabelRef>(arg));
+                    if(!local_jump || label.script.lock() != gen.script)
+                        entry_labels.emplace(&label);
+                }
+            }
+        }
+    }
+
+    return entry_labels;
+}
+
+ControlFlowGraph::ControlFlowGraph(const std::vector<CompiledData>& ir, const IRArena& arena,
+                                   const std::unordered_set<const Label*>& entry_labels, ProgramContext& program) :
+    ir_(ir)
+{
+    auto& commands = program.commands;
+
+    // Whether control never flows from `command` into the next instruction.
+    auto is_terminator = [&](const Command& command)
+    {
+        return commands.equal(command, commands.goto_)
+            || commands.equal(command, commands.return_)
+            || commands.equal(command, commands.terminate_this_script)
+            || commands.equal(command, commands.terminate_this_custom_script)
+            || commands.equal(command, commands.cleo_return);
+    };
+
+    std::unordered_map<uint32_t, uint32_t> label_blocks; //< By label id.
+
+    // Splits the instructions into blocks. A label begins a block, and a jump ends one.
+    for(size_t i = 0; i < ir.size(); ++i)
+    {
+        auto& data = ir[i];
+
+        if(is<CompiledLabelDef>(data.data))
+        {
+            auto label = get<CompiledLabelDef>(data.data).label;
+
+            if(blocks.empty() || blocks.back().begin != i)
+                blocks.emplace_back(i, i, false);
+
+            label_blocks.emplace(label.id, uint32_t(blocks.size() - 1));
+
+            if(entry_labels.count(&arena.label(label)))
+                blocks.back().is_entry = true;
+        }
+        else
+        {
+            if(blocks.empty())
+                blocks.emplace_back(i, i, false);
+
+            if(is<CompiledCommand>(data.data))
+            {
+                auto& command = get<CompiledCommand>(data.data).command;
+                if(is_local_jump(command, commands) || is_terminator(command))
+                {
+                    blocks.back().end = i + 1;
+                    blocks.emplace_back(i + 1, i + 1, false);
+                    continue;
+                }
+            }
+        }
+
+        blocks.back().end = i + 1;
+    }
+
+    if(!blocks.empty() && blocks.back().begin == blocks.back().end)
+        blocks.pop_back();
+
+    if(!blocks.empty())
+        blocks.front().is_entry = true;
+
+    auto add_edge = [&](uint32_t from, uint32_t to)
+    {
+        auto& succs = blocks[from].succs;
+        if(std::find(succs.begin(), succs.end(), to) == succs.end())
+        {
+            succs.push_back(to);
+            blocks[to].preds.push_back(from);
+        }
+    };
+
+    for(uint32_t b = 0; b < blocks.size(); ++b)
+    {
+        auto& block = blocks[b];
+        bool falls_through = true;
+
+        if(block.begin != block.end && is<CompiledCommand>(ir[block.end - 1].data))
+        {
+            auto& ccmd = get<CompiledCommand>(ir[block.end - 1].data);
+
+            if(is_local_jump(ccmd.command, commands))
+            {
+                for(auto& arg : arena.args(ccmd))
+                {
+                    if(is<LabelRef>(arg))
+                    {
+                        auto it = label_blocks.find(get<LabelRef>(arg).id);
+                        if(it != label_blocks.end())
+                            add_edge(b, it->second);
+                    }
+                }
+            }
+
+            if(is_terminator(ccmd.command))
+                falls_through = false;
+        }
+
+        if(falls_through && b + 1 < blocks.size())
+            add_edge(b, b + 1);
+    }
+}
+
+namespace
+{
+/// Tracks the possible entity types of the local variables of a script.
+struct EntityFlowAnalysis
+{
+    /// Possible entity types of a variable, sorted.
+    using EntitySet = small_vector<EntityType, 2>;
+
+    /// The possible entity types of local variables, sorted by variable.
+    /// Variables not in here may hold any entity (e.g. on the entry of the script).
+    using State = std::vector<std::pair<const Var*, EntitySet>>;
+
+    /// A use of a variable which may hold an entity other than the expected.
+    struct Mismatch
+    {
+        const CompiledCommand&  ccmd;
+        const Var*              var;
+        EntityType              got;
+        EntityType              expected;
+    };
+
+    const std::vector<CompiledData>& ir;
+    const IRArena&                   arena;
+    const Commands&                  commands;
+
+    static auto find(State& state, const Var* var) -> State::iterator
+    {
+        return std::lower_bound(state.begin(), state.end(), var, [](const auto& a, const Var* b) {
+            return a.first < b;
+        });
+    }
+
+    static void assign(State& state, const Var* var, EntitySet entities)
+    {
+        auto it = find(state, var);
+        if(it != state.end() && it->first == var)
+            it->second = std::move(entities);
+        else
+            state.emplace(it, var, std::move(entities));
+    }
+
+    static void forget(State& state, const Var* var)
+    {
+        auto it = find(state, var);
+        if(it != state.end() && it->first == var)
+            state.erase(it);
+    }
+
+    /// Gets the variable in `arg` if it is a tracked variable (non-array local).
+    const Var* tracked_var(const ArgVariant& arg) const
+    {
+        if(is<CompiledVar>(arg))
+        {
+            auto& cvar = get<CompiledVar>(arg);
+            auto& var = arena.var(cvar.var);
+            if(!var.global && cvar.index_type == CompiledVar::IndexType::None && var.count == nullopt)
+                return &var;
+        }
+        return nullptr;
+    }
+
+    State entry_state() const
+    {
+        return State();
+    }
+
+    void join(State& into, const State& from) const
+    {
+        // Variables unknown in any of the states are unknown in the result.
+        State result;
+        result.reserve(std::min(into.size(), from.size()));
+
+        auto it_from = from.begin();
+        for(auto& pair : into)
+        {
+            while(it_from != from.end() && it_from->first < pair.first)
+                ++it_from;
+
+            if(it_from != from.end() && it_from->first == pair.first)
+            {
+                EntitySet entities;
+                std::set_union(pair.second.begin(), pair.second.end(),
+                               it_from->second.begin(), it_from->second.end(),
+                               std::back_inserter(entities));
+                result.emplace_back(pair.first, std::move(entities));
+            }
+        }
+
+        into = std::move(result);
+    }
+
+    /// Applies the effects of `ccmd` into `state`.
+    ///
+    /// If `mismatches` is not null, pushes into it the uses which disagree with `state`.
+    void transfer(const CompiledCommand& ccmd, State& state, std::vector<Mismatch>* mismatches) const
+    {
+        auto& command = ccmd.command;
+        auto args = arena.args(ccmd);
+
+        if(mismatches)
+        {
+            for(size_t i = 0; i < args.size(); ++i)
+            {
+                auto var = tracked_var(args[i]);
+                auto arginfo = command.arg(i);
+                if(var == nullptr || !arginfo || arginfo->is_output || arginfo->entity_type == 0)
+                    continue;
+
+                auto it = find(state, var);
+                if(it != state.end() && it->first == var)
+                {
+                    for(auto entity : it->second)
+                    {
+                        if(entity != arginfo->entity_type)
+                        {
+                            mismatches->push_back(Mismatch { ccmd, var, entity, arginfo->entity_type });
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Subroutines share the local variables of the caller, and may change them.
+        if(!ControlFlowGraph::is_local_jump(command, commands) && !commands.equal(command, commands.start_new_script))
+        {
+            for(auto& arg : args)
+            {
+                if(is<LabelRef>(arg))
+                {
+                    state.clear();
+                    break;
+                }
+            }
+        }
+
+        for(size_t i = 0; i < args.size(); ++i)
+        {
+            auto var = tracked_var(args[i]);
+            auto arginfo = command.arg(i);
+            if(var == nullptr || !arginfo || !arginfo->is_output)
+                continue;
+
+            if(arginfo->entity_type != 0)
+                assign(state, var, EntitySet { arginfo->entity_type });
+            else
+                forget(state, var);
+        }
+
+        if(commands.is_alternator(command, commands.set) && args.size() == 2)
+        {
+            if(auto avar = tracked_var(args[0]))
+            {
+                if(auto bvar = tracked_var(args[1]))
+                {
+                    auto it = find(state, bvar);
+                    if(it != state.end() && it->first == bvar)
+                        assign(state, avar, it->second);
+                    else
+                        forget(state, avar);
+                }
+                else if(is<CompiledVar>(args[1]) && arena.var(get<CompiledVar>(args[1]).var).entity != 0)
+                {
+                    assign(state, avar, EntitySet { arena.var(get<CompiledVar>(args[1]).var).entity });
+                }
+                else
+                {
+                    forget(state, avar);
+                }
+            }
+        }
+    }
+
+    void transfer(const ControlFlowGraph::Block& block, State& state) const
+    {
+        for(size_t i = block.begin; i < block.end; ++i)
+        {
+            if(is<CompiledCommand>(ir[i].data))
+                this->transfer(get<CompiledCommand>(ir[i].data), state, nullptr);
+        }
+    }
+};
+}
+
+void check_entity_flow(const std::vector<CodeGenerator>& gens, ProgramContext& program)
+{
+    using Mismatch = EntityFlowAnalysis::Mismatch;
+
+    const auto entry_labels = ControlFlowGraph::find_entry_labels(gens, program);
+
+    std::vector<std::vector<Mismatch>> mismatches(gens.size());
+
+    parallel_for_loop(size_t(0), gens.size(), [&](size_t i)
+    {
+        auto& gen = gens[i];
+
+        ControlFlowGraph cfg(gen.ir(), gen.arena(), entry_labels, program);
+        EntityFlowAnalysis analysis { gen.ir(), gen.arena(), program.commands };
+        ForwardDataflow<EntityFlowAnalysis> dataflow(cfg, analysis);
+
+        dataflow.solve();
+
+        for(size_t b = 0; b < cfg.size(); ++b)
+        {
+            if(!dataflow.is_reachable(b))
+                continue;
+
+            auto& block = cfg.block(b);
+            auto state = dataflow.in_state(b);
+
+            for(size_t k = block.begin; k < block.end; ++k)
+            {
+                if(is<CompiledCommand>(gen.ir()[k].data))
+                    analysis.transfer(get<CompiledCommand>(gen.ir()[k].data), state, &mismatches[i]);
+            }
+        }
+    });
+
+    for(size_t i = 0; i < gens.size(); ++i)
+    {
+        for(auto& mismatch : mismatches[i])
+        {
+            auto got = program.commands.find_entity_name(mismatch.got).value();
+            auto expected = program.commands.find_entity_name(mismatch.expected).value();
+
+            if(mismatch.ccmd.source_begin != mismatch.ccmd.source_end)
+                program.warning(mismatch.ccmd.source(*gens[i].script), "variable may be of type {} in this path, but {} is expected", got, expected);
+            else
+                program.warning(*gens[i].script, "variable may be of type {} in this path, but {} is expected", got, expected);
+        }
+    }
+}
+
+namespace
+{
+/// Simplifies the jumps of the IR of a single script. See `optimize_jumps`.
+struct JumpOptimizer
+{
+    std::vector<CompiledData>&                  ir;
+    IRArena&                                    arena;
+    const std::unordered_set<const Label*>&     entry_labels;
+    ProgramContext&                             program;
+
+    bool is_label_def(size_t i) const
+    {
+        return is<CompiledLabelDef>(ir[i].data);
+    }
+
+    /// Gets the label argument of the GOTO or GOTO_IF_FALSE at `i`, or null if it is something else.
+    LabelRef* jump_target(size_t i, bool conditional) const
+    {
+        auto& commands = program.commands;
+
+        if(!is<CompiledCommand>(ir[i].data))
+            return nullptr;
+
+        auto& ccmd = get<CompiledCommand>(ir[i].data);
+        if(!commands.equal(ccmd.command, commands.goto_)
+            && !(conditional && commands.equal(ccmd.command, commands.goto_if_false)))
+            return nullptr;
+
+        auto args = arena.args(ccmd);
+        if(args.size() != 1 || !is<LabelRef>(args[0]))
+            return nullptr;
+
+        return &get<LabelRef>(args[0]);
+    }
+
+    /// Whether the label `label` may be entered from outside the flow of the script.
+    bool is_entry_label(LabelRef label) const
+    {
+        return entry_labels.count(&arena.label(label)) != 0;
+    }
+
+    /// Calls `f(LabelRef&)` for the label arguments of the local jumps.
+    template<typename Functor>
+    void for_each_jump_target(Functor f)
+    {
+        for(auto& data : ir)
+        {
+            if(!is<CompiledCommand>(data.data))
+                continue;
+
+            auto& ccmd = get<CompiledCommand>(data.data);
+            if(!ControlFlowGraph::is_local_jump(ccmd.command, program.commands))
+                continue;
+
+            for(auto& arg : arena.args(ccmd))
+            {
+                if(is<LabelRef>(arg))
+                    f(get<LabelRef>(arg));
+            }
+        }
+    }
+
+    /// Erases the instructions at the indices marked in `dead`.
+    void erase(const std::vector<bool>& dead)
+    {
+        // Compiled commands are not assignable, thus move the survivors into another vector.
+        std::vector<CompiledData> survivors;
+        survivors.reserve(ir.size());
+        for(size_t i = 0; i < ir.size(); ++i)
+        {
+            if(!dead[i])
+                survivors.push_back(std::move(ir[i]));
+        }
+        ir = std::move(survivors);
+    }
+
+    /// Makes jumps into any label of a sequence of label definitions go into the same label.
+    bool merge_labels()
+    {
+        std::unordered_map<uint32_t, LabelRef> leaders; //< By label id.
+
+        for(size_t i = 0; i < ir.size(); )
+        {
+            size_t end = i;
+            while(end < ir.size() && is_label_def(end))
+                ++end;
+
+            if(end - i >= 2)
+            {
+                // Prefer an entry label as the leader, since those are kept anyway.
+                size_t leader = i;
+                for(size_t k = i; k < end; ++k)
+                {
+                    if(is_entry_label(get<CompiledLabelDef>(ir[k].data).label))
+                    {
+                        leader = k;
+                        break;
+                    }
+                }
+
+                for(size_t k = i; k < end; ++k)
+                {
+                    auto label = get<CompiledLabelDef>(ir[k].data).label;
+                    if(k != leader && !is_entry_label(label))
+                        leaders.emplace(label.id, get<CompiledLabelDef>(ir[leader].data).label);
+                }
+            }
+
+            i = std::max(end, i + 1);
+        }
+
+        if(leaders.empty())
+            return false;
+
+        for_each_jump_target([&](LabelRef& target) {
+            auto it = leaders.find(target.id);
+            if(it != leaders.end())
+                target = it->second;
+        });
+
+        std::vector<bool> dead(ir.size(), false);
+        for(size_t i = 0; i < ir.size(); ++i)
+            dead[i] = is_label_def(i) && leaders.count(get<CompiledLabelDef>(ir[i].data).label.id);
+
+        erase(dead);
+        return true;
+    }
+
+    /// Makes jumps into a GOTO jump straight into the target of the GOTO.
+    bool thread_jumps()
+    {
+        std::unordered_map<uint32_t, size_t> label_defs; //< By label id.
+        for(size_t i = 0; i < ir.size(); ++i)
+        {
+            if(is_label_def(i))
+                label_defs.emplace(get<CompiledLabelDef>(ir[i].data).label.id, i);
+        }
+
+        auto final_target = [&](LabelRef from)
+        {
+            small_vector<uint32_t, 4> visited;
+            LabelRef label = from;
+
+            while(true)
+            {
+                auto it = label_defs.find(label.id);
+                if(it == label_defs.end())
+                    return label;
+
+                size_t i = it->second;
+                while(i < ir.size() && is_label_def(i))
+                    ++i;
+
+                auto next = (i < ir.size()? jump_target(i, false) : nullptr);
+                if(next == nullptr || !label_defs.count(next->id))
+                    return label;
+
+                // Loops made of GOTOs only are left as they are.
+                visited.push_back(label.id);
+                if(std::find(visited.begin(), visited.end(), next->id) != visited.end())
+                    return from;
+
+                label = *next;
+            }
+        };
+
+        bool changed = false;
+        for_each_jump_target([&](LabelRef& target) {
+            auto final = final_target(target);
+            if(final != target)
+            {
+                target = final;
+                changed = true;
+            }
+        });
+        return changed;
+    }
+
+    /// Removes jumps into the instruction right after them.
+    bool remove_jumps_to_next()
+    {
+        std::vector<bool> dead(ir.size(), false);
+        bool changed = false;
+        bool at_top = true;
+
+        for(size_t i = 0; i < ir.size(); ++i)
+        {
+            if(is_label_def(i))
+                continue;
+
+            // A jump on the very top of the script is kept, so no label other than the top one is at offset zero,
+            // which cannot be referenced using local offsets.
+            if(auto target = (!at_top? jump_target(i, true) : nullptr))
+            {
+                for(size_t k = i + 1; k < ir.size() && is_label_def(k); ++k)
+                {
+                    if(get<CompiledLabelDef>(ir[k].data).label == *target)
+                    {
+                        dead[i] = changed = true;
+                        break;
+                    }
+                }
+            }
+
+            at_top = false;
+        }
+
+        if(changed)
+            erase(dead);
+        return changed;
+    }
+
+    /// Removes the instructions which cannot be reached from any entry of the script.
+    bool remove_unreachable()
+    {
+        ControlFlowGraph cfg(ir, arena, entry_labels, program);
+
+        std::vector<bool> reached(cfg.size(), false);
+        std::vector<uint32_t> worklist;
+
+        for(size_t b = 0; b < cfg.size(); ++b)
+        {
+            if(cfg.block(b).is_entry)
+            {
+                reached[b] = true;
+                worklist.push_back(uint32_t(b));
+            }
+        }
+
+        while(!worklist.empty())
+        {
+            auto b = worklist.back();
+            worklist.pop_back();
+
+            for(auto s : cfg.block(b).succs)
+            {
+                if(!reached[s])
+                {
+                    reached[s] = true;
+                    worklist.push_back(s);
+                }
+            }
+        }
+
+        std::vector<bool> dead(ir.size(), false);
+        bool changed = false;
+
+        for(size_t b = 0; b < cfg.size(); ++b)
+        {
+            if(reached[b])
+                continue;
+
+            auto& block = cfg.block(b);
+            for(size_t i = block.begin; i < block.end; ++i)
+                dead[i] = changed = true;
+        }
+
+        if(changed)
+            erase(dead);
+        return changed;
+    }
+
+    void optimize()
+    {
+        for(auto& data : ir)
+        {
+            if(is<CompiledHex>(data.data))
+                return;
+        }
+
+        // Each transformation may give room for the others, thus repeat them until nothing changes.
+        bool changed = true;
+        while(changed)
+        {
+            changed = false;
+            changed |= merge_labels();
+            changed |= thread_jumps();
+            changed |= remove_jumps_to_next();
+            changed |= remove_unreachable();
+        }
+    }
+};
+}
+
+void optimize_jumps(std::vector<CodeGenerator>& gens, ProgramContext& program)
+{
+    const auto entry_labels = ControlFlowGraph::find_entry_labels(gens, program);
+
+    parallel_for_loop(size_t(0), gens.size(), [&](size_t i)
+    {
+        auto& gen = gens[i];
+        JumpOptimizer { gen.ir(), gen.arena(), entry_labels, program }.optimize();
+    });
+}
@@ -0,0 +1,209 @@
+///
+/// Data-flow Analysis
+///
+/// Control flow graphs built from the intermediate representation of a script (see compiler.hpp), plus a
+/// worklist solver for forward data-flow problems over such graphs.
+///
+/// Each script gets its own graph, thus analyses may run on several scripts in parallel.
+///
+#pragma once
+#include <stdinc.h>
+#include "compiler.hpp"
+
+class CodeGenerator;
+
+/// Control flow graph of the IR of a single script.
+class ControlFlowGraph
+{
+public:
+    struct Block
+    {
+        size_t                      begin;      //< Index of the first IR instruction of this block.
+        size_t                      end;        //< Index past the last IR instruction of this block.
+        bool                        is_entry;   //< Whether this block may be entered from outside the flow of the script.
+        small_vector<uint32_t, 2>   succs;      //< Successors of this block.
+        small_vector<uint32_t, 2>   preds;      //< Predecessors of this block.
+
+        explicit Block(size_t begin, size_t end, bool is_entry) :
+            begin(begin), end(end), is_entry(is_entry)
+        {}
+    };
+
+public:
+    /// Builds the graph of the IR `ir` of a script, whose storage is `arena`.
+    ///
+    /// Blocks beginning with any label in `entry_labels` are considered entry points of the script, besides the very
+    /// first block. Those are usually the labels referenced by anything other than a jump inside the script.
+    explicit ControlFlowGraph(const std::vector<CompiledData>& ir, const IRArena& arena,
+                              const std::unordered_set<const Label*>& entry_labels, ProgramContext& program);
+
+    /// Finds the labels which may be entered from outside the flow of their own script.
+    ///
+    /// These are the labels used as an argument of any command except local jumps (GOTO, GOTO_IF_FALSE, ...).
+    static auto find_entry_labels(const std::vector<CodeGenerator>& gens, ProgramContext& program) -> std::unordered_set<const Label*>;
+
+    /// Checks whether `command` transfers control into its label arguments inside the same script.
+    static bool is_local_jump(const Command& command, const Commands& commands);
+
+    /// Number of blocks in this graph.
+    size_t size() const { return this->blocks.size(); }
+
+    /// Gets the block at the specified index.
+    const Block& block(size_t i) const { return this->blocks[i]; }
+
+    /// The IR this graph refers to.
+    const std::vector<CompiledData>& ir() const { return this->ir_; }
+
+private:
+    const std::vector<CompiledData>& ir_;
+    std::vector<Block>               blocks;
+};
+
+/// Worklist solver for forward data-flow problems over a `ControlFlowGraph`.
+///
+/// The `Analysis` object must provide the following:
+///
+///  + `State` type, copyable and equality comparable.
+///  + `State entry_state() const`, the state on the entry of the entry blocks.
+///  + `void join(State& into, const State& from) const`, merges the state of a predecessor into `into`.
+///  + `void transfer(const ControlFlowGraph::Block&, State&) const`, applies the effects of a block into a state.
+///
+/// `Graph` is usually a `ControlFlowGraph`, but anything with the same `size()` and `block(i)` will do.
+///
+/// Blocks which cannot be reached from the entry blocks have no state.
+template<typename Analysis, typename Graph = ControlFlowGraph>
+class ForwardDataflow
+{
+public:
+    using State = typename Analysis::State;
+
+public:
+    explicit ForwardDataflow(const Graph& cfg, const Analysis& analysis) :
+        cfg(cfg), analysis(analysis), in(cfg.size()), out(cfg.size()), reached(cfg.size(), false)
+    {}
+
+    /// Solves the data-flow equations for all the blocks of the graph.
+    void solve()
+    {
+        std::vector<uint32_t> all_blocks(cfg.size());
+        for(size_t b = 0; b < all_blocks.size(); ++b)
+            all_blocks[b] = uint32_t(b);
+
+        this->resolve(all_blocks);
+    }
+
+    /// Solves the data-flow equations again after the transfer of the `changed` blocks has changed
+    /// (e.g. the instructions in such blocks were modified). The edges of the graph must be the same.
+    ///
+    /// Only the blocks reachable from the changed blocks are computed again, the state of the
+    /// remaining blocks cannot depend on the change.
+    void resolve(const std::vector<uint32_t>& changed)
+    {
+        // The dependent blocks are solved from scratch, otherwise facts no longer
+        // produced by a changed block could keep feeding themselves around a loop.
+        std::vector<bool> dependent(cfg.size(), false);
+        std::vector<uint32_t> stack(changed.begin(), changed.end());
+
+        while(!stack.empty())
+        {
+            auto b = stack.back();
+            stack.pop_back();
+
+            if(dependent[b])
+                continue;
+
+            dependent[b] = true;
+            reached[b] = false;
+
+            for(auto s : cfg.block(b).succs)
+                stack.push_back(s);
+        }
+
+        std::deque<uint32_t> worklist;
+        std::vector<bool> in_worklist = dependent;
+
+        for(size_t b = 0; b < cfg.size(); ++b)
+        {
+            if(dependent[b])
+                worklist.push_back(uint32_t(b));
+        }
+
+        while(!worklist.empty())
+        {
+            auto b = worklist.front();
+            worklist.pop_front();
+            in_worklist[b] = false;
+
+            auto& block = cfg.block(b);
+
+            optional<State> new_in;
+            if(block.is_entry)
+                new_in = analysis.entry_state();
+
+            for(auto p : block.preds)
+            {
+                if(!reached[p])
+                    continue;
+                else if(!new_in)
+                    new_in = out[p];
+                else
+                    analysis.join(*new_in, out[p]);
+            }
+
+            if(!new_in) // not reachable, at least not yet
+                continue;
+
+            State new_out = *new_in;
+            analysis.transfer(block, new_out);
+            in[b] = std::move(*new_in);
+
+            if(!reached[b] || !(new_out == out[b]))
+            {
+                out[b] = std::move(new_out);
+                reached[b] = true;
+
+                for(auto s : block.succs)
+                {
+                    if(!in_worklist[s])
+                    {
+                        in_worklist[s] = true;
+                        worklist.push_back(s);
+                    }
+                }
+            }
+        }
+    }
+
+    /// Checks whether the block `b` is reachable from any entry block.
+    bool is_reachable(size_t b) const { return this->reached[b]; }
+
+    /// State on the entry of block `b`.
+    const State& in_state(size_t b) const { Expects(reached[b]); return this->in[b]; }
+
+    /// State on the exit of block `b`.
+    const State& out_state(size_t b) const { Expects(reached[b]); return this->out[b]; }
+
+private:
+    const Graph&            cfg;
+    const Analysis&         analysis;
+    std::vector<State>      in;
+    std::vector<State>      out;
+    std::vector<bool>       reached;
+};
+
+/// Checks, using flow-sensitive analysis, whether local variables may hold entities
+/// of an unexpected type in any path to their uses.
+///
+/// The scripts are analyzed in parallel, but the diagnostics are emitted in the order of `gens`.
+void check_entity_flow(const std::vector<CodeGenerator>& gens, ProgramContext& program);
+
+/// Simplifies the jumps the compiler leaves behind when lowering the control flow statements.
+///
+/// Jumps into jumps are threaded, jumps into the next instruction are removed, instructions which cannot be reached
+/// are dropped, and labels defined at the same position are merged. Labels which may be entered from outside
+/// the flow of their script are always kept.
+///
+/// Scripts containing DUMP blocks are left as is, since the raw bytes may be either code or data.
+///
+/// The scripts are optimized in parallel. No diagnostics are emitted.
+void optimize_jumps(std::vector<CodeGenerator>& gens, ProgramContext& program);
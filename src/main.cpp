@@ -19,6 +19,10 @@ Options:
                            The compiler will still try to behave properly
                            without this, but this is still recommended.
   --levelfile=<name>       Name of the level data file in the data directory.
+  --builtin-config=<name>  Same as --config, but uses the configuration built
+                           into the executable, thus not reading the '/config/'
+                           directory at all. Only available if the compiler was
+                           built with GTA3SC_BUILTIN_CONFIG.
   --add-config=<path>      Adds an additional XML definition file.
                            If the path is not absolute or starts with './' or
                            '../', uses a path relative to 'config/<name>/'.
@@ -33,6 +37,8 @@ Options:
   -O                       Enables optimizations.
   -emit-ir2                Emits a explicit IR based on Sanny Builder syntax.
   -fsyntax-only            Only checks the syntax, i.e. doesn't generate code.
+  --low-memory             Releases the source text and syntax tree of the
+                           scripts as soon as they are compiled into IR.
   --recursive-traversal    Disassembler scans the code by the means of a
                            recursive traversal instead of linear-sweep.
   --expect-var=<info>
@@ -74,6 +80,10 @@ Machine Options:
   -mtyped-text-label       Codegen uses GTA SA text label data type.
   -moptimize-andor         Omits compiling ANDOR on single condition statements.
   -moptimize-zero          Compiles 0.0 as 0, using a 8 bit data type.
+  -moptimize-jumps         Threads jumps into jumps, and removes needless jumps
+                           and unreachable commands.
+  -moptimize-switch        Compiles large SWITCH statements as a binary search
+                           when SWITCH_START is not available.
   -moatc                   Uses the Custom Commands Header whenever possible.
 
 Error Message Options:
@@ -86,6 +96,9 @@ Error Message Options:
                             names.
   -Wexpect-var             Warns if any of the variables specified with
                            the --expect-var option is out of place.
+  -Wentity-flow            Warns when a local variable may hold an entity of
+                           an unexpected type in any path to its use. Unlike
+                           -fentity-tracking, follows the flow of the script.
   -fconstant-checks        Checks whether variables collides with constants.
 )";
 
@@ -106,6 +119,7 @@ enum class Action
     Decompile,
     QueryConfigPath,
     QueryModels,
+    EmitBuiltinCommands,
 };
 
 
@@ -119,8 +133,51 @@ struct ConfigInfo
 {
     std::string           config_name;
     std::vector<fs::path> add_config_files;
+    bool                  builtin = false;      //< Whether config_name is built into the executable.
 };
 
+/// Lists the XML files which make up the configuration `conf`.
+std::vector<fs::path> config_files(const ConfigInfo& conf, bool with_default_xml, bool with_cleo_xml)
+{
+    std::vector<fs::path> config_files;
+    config_files.reserve(6 + conf.add_config_files.size());
+
+    if(conf.builtin)
+        config_files.emplace_back("gta3sc.xml");
+    else
+        config_files.emplace_back(config_path() / "gta3sc.xml");
+    config_files.emplace_back("alternators.xml");
+    config_files.emplace_back("commands.xml");
+    config_files.emplace_back("constants.xml");
+    if(with_default_xml) config_files.emplace_back("default.xml");
+    if(with_cleo_xml) config_files.emplace_back("cleo.xml");
+    std::copy(conf.add_config_files.begin(), conf.add_config_files.end(), std::back_inserter(config_files));
+
+    return config_files;
+}
+
+bool parse_args(char**& argv, fs::path& input, fs::path& output, DataInfo& data, ConfigInfo& conf, Options& options);
+
+/// Parses the arguments in a commandline.txt file.
+bool parse_cmdline(std::string cmdline, fs::path& input, fs::path& output, DataInfo& data, ConfigInfo& conf, Options& options)
+{
+    small_vector<char*, 128> args;
+
+    auto it = !cmdline.empty()? &cmdline[0] : nullptr;
+    auto end = it + cmdline.size();
+    for(; it != end; )
+    {
+        it = std::find_if_not(it, end, ::isspace);
+        args.emplace_back(it);
+        it = std::find_if(it, end, ::isspace);
+        if(it != end) *it++ = '\0';
+    }
+    args.emplace_back(nullptr);
+
+    char** argv2 = args.data();
+    return parse_args(argv2, input, output, data, conf, options);
+}
+
 bool parse_args(char**& argv, fs::path& input, fs::path& output, DataInfo& data, ConfigInfo& conf, Options& options)
 {
     try
@@ -183,29 +240,15 @@ bool parse_args(char**& argv, fs::path& input, fs::path& output, DataInfo& data,
             else if(const char* name = optget(argv, nullptr, "--config", 1))
             {
                 // avoid infinite recursion of parse_args(...) calls
-                if(iequal_to()(conf.config_name, name))
+                if(iequal_to()(conf.config_name, name) && !conf.builtin)
                     continue;
 
                 conf.config_name = name;
+                conf.builtin = false;
 
                 if(auto opt_cmdline = read_file_utf8(config_path() / conf.config_name / "commandline.txt"))
                 {
-                    auto& cmdline = *opt_cmdline;
-                    small_vector<char*, 128> args;
-
-                    auto it = !cmdline.empty()? &cmdline[0] : nullptr;
-                    auto end = it + cmdline.size();
-                    for(; it != end; )
-                    {
-                        it = std::find_if_not(it, end, ::isspace);
-                        args.emplace_back(it);
-                        it = std::find_if(it, end, ::isspace);
-                        if(it != end) *it++ = '\0';
-                    }
-                    args.emplace_back(nullptr);
-
-                    char** argv2 = args.data();
-                    if(!parse_args(argv2, input, output, data, conf, options))
+                    if(!parse_cmdline(std::move(*opt_cmdline), input, output, data, conf, options))
                         return false;
                 }
                 else
@@ -214,6 +257,32 @@ bool parse_args(char**& argv, fs::path& input, fs::path& output, DataInfo& data,
                     return false;
                 }
             }
+            else if(const char* name = optget(argv, nullptr, "--builtin-config", 1))
+            {
+                // avoid infinite recursion of parse_args(...) calls
+                if(iequal_to()(conf.config_name, name) && conf.builtin)
+                    continue;
+
+                if(!has_builtin_config(name))
+                {
+                    fprintf(stderr, "gta3sc: error: config '%s' is not built into this executable\n", name);
+                    return false;
+                }
+
+                conf.config_name = name;
+                conf.builtin = true;
+
+                if(auto opt_cmdline = find_builtin_config(conf.config_name, "commandline.txt"))
+                {
+                    if(!parse_cmdline(opt_cmdline->to_string(), input, output, data, conf, options))
+                        return false;
+                }
+                else
+                {
+                    fprintf(stderr, "gta3sc: error: builtin config is missing commandline.txt file\n");
+                    return false;
+                }
+            }
             else if(const char* path = optget(argv, nullptr, "--add-config", 1))
             {
                 conf.add_config_files.emplace_back(path);
@@ -276,10 +345,20 @@ bool parse_args(char**& argv, fs::path& input, fs::path& output, DataInfo& data,
             {
                 options.optimize_zero_floats = flag;
             }
+            else if(optflag(argv, "-moptimize-jumps", &flag))
+            {
+                options.optimize_jumps = flag;
+            }
+            else if(optflag(argv, "-moptimize-switch", &flag))
+            {
+                options.optimize_switch = flag;
+            }
             else if(optget(argv, nullptr, "-O", 0))
             {
                 options.optimize_andor = true;
                 options.optimize_zero_floats = true;
+                options.optimize_jumps = true;
+                options.optimize_switch = true;
             }
             else if(optflag(argv, "-fentity-tracking", &flag))
             {
@@ -355,6 +434,10 @@ bool parse_args(char**& argv, fs::path& input, fs::path& output, DataInfo& data,
             {
                 options.fsyntax_only = true;
             }
+            else if(optget(argv, nullptr, "--low-memory", 0))
+            {
+                options.low_memory = true;
+            }
             else if(optflag(argv, "-emit-ir2", nullptr))
             {
                 options.emit_ir2 = true;
@@ -395,6 +478,10 @@ bool parse_args(char**& argv, fs::path& input, fs::path& output, DataInfo& data,
             {
                 options.warn_expect_var = flag;
             }
+            else if(optflag(argv, "-Wentity-flow", &flag))
+            {
+                options.warn_entity_flow = flag;
+            }
             else if(optflag(argv, "-fconstant-checks", &flag))
             {
                 options.constant_checks = flag;
@@ -463,6 +550,11 @@ int main(int argc, char** argv)
             ++argv;
             action = Action::QueryModels;
         }
+        else if(!strcmp(*argv, "emit-builtin-commands"))
+        {
+            ++argv;
+            action = Action::EmitBuiltinCommands;
+        }
     }
 
     if(!parse_args(argv, input, output, data, conf, options))
@@ -482,6 +574,42 @@ int main(int argc, char** argv)
         return EXIT_SUCCESS;
     }
 
+    if(action == Action::EmitBuiltinCommands)
+    {
+        // Used by the build to generate the tables of a configuration built into the executable.
+        if(!conf.builtin || output.empty())
+        {
+            fprintf(stderr, "gta3sc: error: usage: gta3sc emit-builtin-commands --builtin-config=<name> -o <file>\n");
+            return EXIT_FAILURE;
+        }
+
+        try
+        {
+            std::vector<std::vector<fs::path>> xml_lists;
+            for(bool with_cleo_xml : { false, true })
+            {
+                for(bool with_default_xml : { true, false })
+                    xml_lists.emplace_back(config_files(conf, with_default_xml, with_cleo_xml));
+            }
+
+            std::string symbol = "builtin_commands_" + conf.config_name;
+            std::replace_if(symbol.begin(), symbol.end(), [](char c) { return !isalnum(static_cast<unsigned char>(c)); }, '_');
+
+            auto source = Commands::to_builtin_source(conf.config_name, symbol, xml_lists);
+            if(!write_file(output, source.data(), source.size()))
+            {
+                fprintf(stderr, "gta3sc: error: could not write to output file '%s'\n", output.generic_u8string().c_str());
+                return EXIT_FAILURE;
+            }
+            return EXIT_SUCCESS;
+        }
+        catch(const ConfigError& e)
+        {
+            fprintf(stderr, "gta3sc: error: %s\n", e.what());
+            return EXIT_FAILURE;
+        }
+    }
+
     if(input.empty())
     {
         fprintf(stderr, "gta3sc: error: no input file\n");
@@ -579,18 +707,12 @@ int main(int argc, char** argv)
 
     try
     {
-        std::vector<fs::path> config_files;
-        config_files.reserve(6 + conf.add_config_files.size());
+        auto xml_list = config_files(conf, data.datadir.empty(), options.cleo != nullopt);
 
-        config_files.emplace_back(config_path() / "gta3sc.xml");
-        config_files.emplace_back("alternators.xml");
-        config_files.emplace_back("commands.xml");
-        config_files.emplace_back("constants.xml");
-        if(data.datadir.empty()) config_files.emplace_back("default.xml");
-        if(options.cleo) config_files.emplace_back("cleo.xml");
-        std::move(conf.add_config_files.begin(), conf.add_config_files.end(), std::back_inserter(config_files));
-
-        Commands commands = Commands::from_xml(conf.config_name, config_files);
+        optional<Commands> opt_builtin_commands = conf.builtin? Commands::from_builtin(conf.config_name, xml_list) : nullopt;
+
+        Commands commands = opt_builtin_commands? std::move(*opt_builtin_commands) :
+                                                  Commands::from_xml(conf.config_name, xml_list, conf.builtin);
         commands.add_default_models(default_models);
 
         program.emplace(std::move(options), std::move(commands));
@@ -602,9 +724,6 @@ int main(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
-    fs::path conf_path = config_path();
-    //fprintf(stderr, "gta3sc: using '%s' as configuration path\n", conf_path.generic_u8string().c_str());
-
     switch(action)
     {
         case Action::Compile:
@@ -616,7 +735,7 @@ int main(int argc, char** argv)
             if(input == "default" || input == "all")
             {
                 fprintf(stdout, "=DEFAULT\n");
-                for(auto& pair : program->commands.get_defaultmodel_enum()->values)
+                for(auto& pair : program->commands.get_defaultmodel_enum()->values())
                 {
                     fprintf(stdout, "%s %u\n", pair.first.c_str(), pair.second);
                 }
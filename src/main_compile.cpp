@@ -3,6 +3,7 @@
 #include "parser.hpp"
 #include "symtable.hpp"
 #include "codegen.hpp"
+#include "dataflow.hpp"
 #include "cdimage.hpp"
 
 using RequiredFrom = std::vector<weak_ptr<const Script>>;
@@ -32,7 +33,7 @@ namespace
 
     auto generate_ir(const SymTable&, std::vector<shared_ptr<Script>>& scripts, ProgramContext& program) -> std::vector<CodeGenerator>;
 
-    void generate_scm(std::vector<CodeGenerator>&);
+    void resolve_labels(std::vector<CodeGenerator>&);
 
     auto build_headers(std::vector<CodeGenerator>& gens, const SymTable& symbols, const std::vector<std::string>& models,
                        const shared_ptr<const Script> main, std::vector<shared_ptr<Script>>& scripts,
@@ -42,7 +43,7 @@ namespace
                          std::vector<shared_ptr<Script>>& scripts, ProgramContext& program);
 
     template<typename Writeable1, typename Writeable2> static
-    void generate_output(const std::vector<CodeGenerator>& gens,
+    void generate_output(std::vector<CodeGenerator>& gens,
                          const MultiFileHeaderList& multi_headers,
                          Writeable1& main_scm, Writeable2& script_img, bool has_script_img,
                          ProgramContext& program);
@@ -131,17 +132,30 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
 
         auto gens = generate_ir(symbols, scripts, program);
 
+        if(program.opt.warn_entity_flow)
+            check_entity_flow(gens, program);
+
         if(program.has_error())
             throw ProgramFailure();
 
         if(program.opt.fsyntax_only)
             return EXIT_SUCCESS;
 
+        if(program.opt.optimize_jumps)
+            optimize_jumps(gens, program);
+
+        if(program.opt.low_memory)
+        {
+            // Nothing past this point needs the source text nor the syntax trees.
+            for(auto& script : scripts)
+                script->release_source();
+        }
+
         auto multi_headers = build_headers(gens, symbols, models, main, scripts, program);
 
         compute_offsets(gens, multi_headers, scripts, program);
         
-        generate_scm(gens);
+        resolve_labels(gens);
 
         if(program.has_error())
             throw ProgramFailure();
@@ -184,20 +198,16 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
         }
         else
         {
-            FILE *main_scm = 0, *script_img = 0;
+            // Opened for reading as well, since memory mapping the files requires so.
+            MappedFile main_scm, script_img;
 
-            auto guard = make_scope_guard([&] {
-                if(main_scm) fclose(main_scm);
-                if(script_img) fclose(script_img);
-            });
-
-            main_scm = u8fopen(output, "wb");
-            if(main_scm == nullptr)
+            main_scm.file = u8fopen(output, "w+b");
+            if(!main_scm)
                 program.fatal_error(nocontext, "failed to open output for writing");
 
             if(use_script_img)
             {
-                script_img = u8fopen(fs::path(output).replace_filename("script.img"), "wb");
+                script_img.file = u8fopen(fs::path(output).replace_filename("script.img"), "w+b");
                 if(!script_img)
                     program.fatal_error(nocontext, "failed to open script.img for writing");
             }
@@ -480,10 +490,14 @@ void compute_offsets(std::vector<CodeGenerator>& gens, const MultiFileHeaderList
 {
     assert(gens.size() == scripts.size());
 
-    for_loop(size_t(0), gens.size(), [&](size_t i) {
-        scripts[i]->code_size = gens[i].compute_labels();
+    // Each generator only touches the labels defined in its own script.
+    parallel_for_loop(size_t(0), gens.size(), [&](size_t i) {
+        scripts[i]->code_size = gens[i].emit();
     });
 
+    for(auto& gen : gens)
+        gen.report_issues();
+
     Script::compute_script_offsets(scripts, multi_headers);
 }
 
@@ -499,19 +513,39 @@ auto generate_ir(const SymTable& symbols, std::vector<shared_ptr<Script>>& scrip
     return gens;
 }
 
-void generate_scm(std::vector<CodeGenerator>& gens)
+void resolve_labels(std::vector<CodeGenerator>& gens)
 {
-    std::for_each(gens.begin(), gens.end(), [&](auto& gen) {
-        gen.generate();
+    parallel_for_loop(size_t(0), gens.size(), [&](size_t i) {
+        gens[i].resolve_labels();
     });
+
+    // Report in order, independently of how the work was scheduled.
+    for(auto& gen : gens)
+        gen.report_issues();
 }
 
 template<typename Writeable1, typename Writeable2>
-void generate_output(const std::vector<CodeGenerator>& gens,
+void generate_output(std::vector<CodeGenerator>& gens,
                      const MultiFileHeaderList& multi_headers,
                      Writeable1& main_scm, Writeable2& script_img, bool has_script_img,
                      ProgramContext& program)
 {
+    // Calls `generate(void*)` to produce the `size` bytes at `offset` of the output, straight into the
+    // memory of the output file whenever it is possible.
+    auto generate_into = [](auto& output_file, size_t offset, size_t size, auto generate)
+    {
+        if(void* region = file_region(output_file, offset, size))
+        {
+            generate(region);
+        }
+        else
+        {
+            std::unique_ptr<uint8_t[]> buffer(new uint8_t[size]);
+            generate(buffer.get());
+            write_file(output_file, offset, buffer.get(), size);
+        }
+    };
+
     auto write_headers = [&](auto& output_file, size_t offset, const shared_ptr<const Script>& script) -> size_t
     {
         size_t total_size = 0;
@@ -520,16 +554,20 @@ void generate_output(const std::vector<CodeGenerator>& gens,
             for(auto& header : *opt)
             {
                 CodeGeneratorData hgen(script, total_size, header, program);
-                hgen.generate();
-                write_file(output_file, offset, hgen.buffer(), hgen.buffer_size());
-                total_size += hgen.buffer_size();
-                offset += hgen.buffer_size();
+                generate_into(output_file, offset, hgen.compiled_size(), [&](void* output) { hgen.generate(output); });
+                total_size += hgen.compiled_size();
+                offset += hgen.compiled_size();
             }
         }
         return total_size;
     };
 
-    std::vector<std::pair<std::string, const CodeGenerator*>> into_script_img;
+    auto write_code = [&](auto& output_file, size_t offset, CodeGenerator& gen)
+    {
+        generate_into(output_file, offset, gen.script->code_size.value(), [&](void* output) { gen.generate(output); });
+    };
+
+    std::vector<std::pair<std::string, CodeGenerator*>> into_script_img;
 
     assert(gens[0].script->is_main_script());
     auto scmheader = multi_headers.find_header<CompiledScmHeader>(gens[0].script);
@@ -543,18 +581,29 @@ void generate_output(const std::vector<CodeGenerator>& gens,
     if(!allocate_file_space(main_scm, multifile_size))
         program.fatal_error(nocontext, "failed to allocate disk space for the main file");
 
-    for(const auto& gen : gens)
+    // Every script is written into its own region of the output, thus the order of writing does not matter.
+    auto for_each_region = [](auto& output_file, size_t count, auto functor)
+    {
+        if(can_write_concurrently(output_file))
+            parallel_for_loop(size_t(0), count, std::move(functor));
+        else
+            for_loop(size_t(0), count, std::move(functor));
+    };
+
+    for_each_region(main_scm, gens.size(), [&](size_t i)
     {
+        auto& gen = gens[i];
         if(!gen.script->is_child_of(ScriptType::StreamedScript))
         {
             write_headers(main_scm, gen.script->base.value(), gen.script);
-            write_file(main_scm, gen.script->code_offset.value(), gen.buffer(), gen.buffer_size());
-        }
-        else
-        {
-            if(gen.script->type != ScriptType::Required)
-                into_script_img.emplace_back(gen.script->path.stem().u8string(), &gen);
+            write_code(main_scm, gen.script->code_offset.value(), gen);
         }
+    });
+
+    for(auto& gen : gens)
+    {
+        if(gen.script->is_child_of(ScriptType::StreamedScript) && gen.script->type != ScriptType::Required)
+            into_script_img.emplace_back(gen.script->path.stem().u8string(), &gen);
     }
 
     std::sort(into_script_img.begin(), into_script_img.end(), [](const auto& lhs, const auto& rhs) {
@@ -627,24 +676,24 @@ void generate_output(const std::vector<CodeGenerator>& gens,
         // aaa.scm
         write_file(script_img, directory[0].offset * 2048, &aaa_scm, sizeof(aaa_scm));
 
-        for(size_t i = 0; i < into_script_img.size(); ++i)
+        for_each_region(script_img, into_script_img.size(), [&](size_t i)
         {
-            const CodeGenerator& gen = *into_script_img[i].second;
+            CodeGenerator& gen = *into_script_img[i].second;
 
             size_t offset = directory[1+i].offset * 2048;
             offset += write_headers(script_img, offset, gen.script);
 
-            write_file(script_img, offset, gen.buffer(), gen.buffer_size());
-            offset += gen.buffer_size();
+            write_code(script_img, offset, gen);
+            offset += gen.script->code_size.value();
 
             for(auto& weakp : gen.script->children_scripts)
             {
                 auto required_script = weakp.lock();
                 auto& required_gen = *std::find_if(gens.begin(), gens.end(), [&](const auto& g) { return g.script == required_script; });
-                write_file(script_img, offset, required_gen.buffer(), required_gen.buffer_size());
-                offset += required_gen.buffer_size();
+                write_code(script_img, offset, required_gen);
+                offset += required_script->code_size.value();
             }
-        }
+        });
 
         assert(file_tell(script_img) <= end_offset);
     }
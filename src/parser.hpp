@@ -387,10 +387,67 @@ public:
     template<typename Functor>  // Functor = bool(SyntaxTree)
     void depth_first(Functor fun) //const
     {
-        if(fun(*this))
+        struct PreOrderVisitor
         {
-            for(auto& child : *this)
-                child->depth_first(std::ref(fun));
+            Functor& fun;
+            bool pre(SyntaxTree& node) { return fun(node); }
+            void post(SyntaxTree&)     {}
+        } visitor { fun };
+
+        this->visit(visitor);
+    }
+
+    /// Performs a depth-first traversal on this tree, calling `pre()` before visiting
+    /// the childs of a node and `post()` after them.
+    ///
+    /// Does not go any deeper in a node that `pre()` returns false, neither calls `post()` on it.
+    template<typename PreFunctor, typename PostFunctor> // PreFunctor = bool(SyntaxTree), PostFunctor = void(SyntaxTree)
+    void depth_first(PreFunctor pre, PostFunctor post)
+    {
+        struct PrePostVisitor
+        {
+            PreFunctor&  pre_fun;
+            PostFunctor& post_fun;
+            bool pre(SyntaxTree& node)  { return pre_fun(node); }
+            void post(SyntaxTree& node) { post_fun(node); }
+        } visitor { pre, post };
+
+        this->visit(visitor);
+    }
+
+    /// Performs a depth-first traversal on this tree, calling `visitor.pre(node)` before
+    /// visiting the childs of a node and `visitor.post(node)` after them.
+    ///
+    /// Does not go any deeper in a node that `pre()` returns false, neither calls `post()` on it.
+    ///
+    /// The traversal uses an explicit stack instead of recursion, so deeply nested trees are fine.
+    template<typename Visitor>  // Visitor = { bool pre(SyntaxTree&); void post(SyntaxTree&); }
+    void visit(Visitor& visitor)
+    {
+        // (node, index of the next child to visit)
+        small_vector<std::pair<SyntaxTree*, size_t>, 32> stack;
+
+        if(!visitor.pre(*this))
+            return;
+
+        stack.emplace_back(this, 0);
+
+        while(!stack.empty())
+        {
+            SyntaxTree* node = stack.back().first;
+            size_t child_id = stack.back().second++;
+
+            if(child_id < node->child_count())
+            {
+                SyntaxTree& child = node->child(child_id);
+                if(visitor.pre(child))
+                    stack.emplace_back(&child, 0);
+            }
+            else
+            {
+                stack.pop_back();
+                visitor.post(*node);
+            }
         }
     }
 
@@ -448,6 +505,14 @@ public:
         return this->instream? this->instream->tstream : weak_ptr<const TokenStream>();
     }
 
+    /// Matches `value`, which must be the text of this node or a suffix of it, as a `Miss2Identifier`.
+    ///
+    /// On `Text` nodes the text is parsed only once, further calls with the same `value` reuse the
+    /// result cached in the input stream of the node.
+    ///
+    /// \warning this method is not thread-safe on nodes of the same input stream.
+    auto identifier(const string_view& value, const Options& options) const -> expected<Miss2Identifier, Miss2Identifier::Error>;
+
     ///
     const TokenStream::TokenData get_token() const
     {
@@ -462,14 +527,35 @@ protected:
     friend class TokenStream;
     friend struct ParserContext;
 
+    /// Compact result of `Miss2Identifier::match` on the text of a node, see `identifier()`.
+    struct IdentifierCache
+    {
+        enum Kind : uint8_t { NotParsed, NoIndex, NumberIndex, AtomIndex, Failure };
+
+        Kind     kind = NotParsed;
+        uint8_t  error;         //< The `Miss2Identifier::Error` if `kind == Failure`.
+        uint16_t skip;          //< Number of characters of the text skipped before matching.
+        uint32_t ident_size;    //< Size of the identifier (after `skip`).
+        uint32_t index;         //< Index value for `NumberIndex`, offset of the index (after `skip`) for `AtomIndex`.
+        uint32_t index_size;    //< Size of the index for `AtomIndex`.
+    };
+
     struct InputStream
     {
         shared_ptr<std::string>     filename;   //< Name of the input file. Stored also here because tstream may get deallocated.
         weak_ptr<const TokenStream> tstream;    //< Input token stream, if still allocated.
+
+        /// Identifiers matched on the `Text` nodes of this stream, indexed by `SyntaxTree::text_id`.
+        ///
+        /// \warning not thread-safe, the nodes of a stream must not call `identifier()` concurrently.
+        mutable std::vector<IdentifierCache> ident_cache;
     };
 
 private:
+    static constexpr uint32_t no_text_id = UINT32_MAX;
+
     NodeType                                    type_;  // const NodeType
+    uint32_t                                    text_id = no_text_id; // index in instream->ident_cache (Text nodes only)
     TokenStream::TokenData                      token;      // invalid if (instream == nullptr)
     shared_ptr<InputStream>                     instream;   // may be nullptr
     std::vector<std::shared_ptr<SyntaxTree>>    childs;
@@ -485,6 +571,11 @@ public:
     explicit SyntaxTree(NodeType type, shared_ptr<InputStream>& instream, const TokenStream::TokenData& token)
         : type_(type), instream(instream), token(token)
     {
+        if(type == NodeType::Text)
+        {
+            this->text_id = uint32_t(instream->ident_cache.size());
+            instream->ident_cache.emplace_back();
+        }
     }
 
     explicit SyntaxTree(NodeType type)
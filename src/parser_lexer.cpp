@@ -892,6 +892,70 @@ auto Miss2Identifier::match(const string_view& value, const Options& options) ->
     return Miss2Identifier{ value, nullopt };
 }
 
+auto SyntaxTree::identifier(const string_view& value, const Options& options) const -> expected<Miss2Identifier, Miss2Identifier::Error>
+{
+    auto text = this->text();
+    Expects(value.data() >= text.data() && value.data() + value.size() == text.data() + text.size());
+
+    if(this->text_id == no_text_id || this->instream == nullptr)
+        return Miss2Identifier::match(value, options);
+
+    auto skip = uint16_t(value.data() - text.data());
+    auto& cache = this->instream->ident_cache[this->text_id];
+
+    if(cache.kind == IdentifierCache::NotParsed || cache.skip != skip)
+    {
+        auto opt_token = Miss2Identifier::match(value, options);
+
+        cache.skip = skip;
+
+        if(!opt_token)
+        {
+            cache.kind = IdentifierCache::Failure;
+            cache.error = uint8_t(opt_token.error());
+        }
+        else
+        {
+            cache.ident_size = uint32_t(opt_token->identifier.size());
+
+            if(opt_token->index == nullopt)
+            {
+                cache.kind = IdentifierCache::NoIndex;
+            }
+            else if(is<size_t>(*opt_token->index))
+            {
+                cache.kind = IdentifierCache::NumberIndex;
+                cache.index = uint32_t(get<size_t>(*opt_token->index));
+            }
+            else
+            {
+                auto& index = get<string_view>(*opt_token->index);
+                cache.kind = IdentifierCache::AtomIndex;
+                cache.index = uint32_t(index.data() - value.data());
+                cache.index_size = uint32_t(index.size());
+            }
+        }
+
+        return opt_token;
+    }
+
+    using index_type = decltype(Miss2Identifier::index);
+
+    switch(cache.kind)
+    {
+        case IdentifierCache::Failure:
+            return make_unexpected(Miss2Identifier::Error(cache.error));
+        case IdentifierCache::NoIndex:
+            return Miss2Identifier{ value.substr(0, cache.ident_size), nullopt };
+        case IdentifierCache::NumberIndex:
+            return Miss2Identifier{ value.substr(0, cache.ident_size), index_type(size_t(cache.index)) };
+        case IdentifierCache::AtomIndex:
+            return Miss2Identifier{ value.substr(0, cache.ident_size), index_type(value.substr(cache.index, cache.index_size)) };
+        default:
+            Unreachable();
+    }
+}
+
 bool Miss2Identifier::is_identifier(const string_view& value, const Options& options)
 {
     auto first_char = value.empty()? '\0' : value.front();
@@ -905,6 +969,27 @@ bool Miss2Identifier::is_identifier(const string_view& value, const Options& opt
         return (first_char >= 'a' && first_char <= 'z') || (first_char >= 'A' && first_char <= 'Z') || first_char == '$';
 }
 
+/// Converts integer literals in the common form `-?[1-9][0-9]{0,8}` (or zero) without
+/// any allocation. Returns `nullopt` for anything else (hexadecimal, octal, out of range, ...).
+static optional<int32_t> to_simple_integer(const string_view& number)
+{
+    size_t i = (!number.empty() && number[0] == '-')? 1 : 0;
+    size_t num_digits = number.size() - i;
+
+    if(num_digits == 0 || num_digits > 9 || (number[i] == '0' && num_digits != 1))
+        return nullopt;
+
+    int32_t value = 0;
+    for(; i < number.size(); ++i)
+    {
+        if(number[i] < '0' || number[i] > '9')
+            return nullopt;
+        value = value * 10 + (number[i] - '0');
+    }
+
+    return number[0] == '-'? -value : value;
+}
+
 optional<int32_t> to_integer(const SyntaxTree& node, ProgramContext& program)
 {
     Expects(node.type() == NodeType::Integer);
@@ -913,7 +998,11 @@ optional<int32_t> to_integer(const SyntaxTree& node, ProgramContext& program)
     {
         auto number = node.text();
 
-        if(number.size() > 2+7 && number[0] == '0' && (number[1] == 'x' || number[1] == 'X'))
+        if(auto value = to_simple_integer(number))
+        {
+            return *value;
+        }
+        else if(number.size() > 2+7 && number[0] == '0' && (number[1] == 'x' || number[1] == 'X'))
         {
             auto ll = std::stoll(number.to_string(), 0, 0);
             static_assert(sizeof(ll) == sizeof(int32_t) * 2, "");
@@ -953,7 +1042,26 @@ optional<float> to_float(const SyntaxTree& node, ProgramContext& program)
 
     try
     {
-        return std::stof(node.text().to_string());
+        auto number = node.text();
+
+        // Same as std::stof, but avoids allocating a string for the common short literals.
+        char buffer[64];
+        if(number.size() < sizeof(buffer))
+        {
+            std::memcpy(buffer, number.data(), number.size());
+            buffer[number.size()] = '\0';
+
+            char* endptr;
+            errno = 0;
+            float value = std::strtof(buffer, &endptr);
+            if(endptr == buffer)
+                throw std::invalid_argument("stof");
+            if(errno == ERANGE)
+                throw std::out_of_range("stof");
+            return value;
+        }
+
+        return std::stof(number.to_string());
     }
     catch(const std::out_of_range&)
     {
@@ -1362,7 +1362,7 @@ static ParserResult parse_statement(ParserContext& parser, token_iterator begin,
 //
 
 SyntaxTree::SyntaxTree(SyntaxTree&& rhs)
-    : type_(rhs.type_), token(std::move(rhs.token)), childs(std::move(rhs.childs)), parent_(std::move(rhs.parent_)),
+    : type_(rhs.type_), text_id(rhs.text_id), token(std::move(rhs.token)), childs(std::move(rhs.childs)), parent_(std::move(rhs.parent_)),
       udata(std::move(rhs.udata)), instream(std::move(rhs.instream))
 {
     rhs.type_ = NodeType::Block;
@@ -1374,6 +1374,7 @@ shared_ptr<SyntaxTree> SyntaxTree::clone() const
     shared_ptr<SyntaxTree> tree(new SyntaxTree(this->type_));
     tree->token = this->token;
     tree->instream = this->instream;
+    tree->text_id = this->text_id;
     tree->udata = this->udata;
 
     for(auto& child : this->childs)
@@ -34,6 +34,8 @@ inline std::string format_error(const Options&, const char* type, const Script&
 template<typename... Args>
 inline std::string format_error(const Options&, const char* type, const TokenStream::TokenInfo& context, const char* msg, Args&&... args);
 template<typename... Args>
+inline std::string format_error(const Options&, const char* type, const SourceRange& context, const char* msg, Args&&... args);
+template<typename... Args>
 inline std::string format_error(const Options&, const char* type, const SyntaxTree& context_, const char* msg, Args&&... args);
 template<typename T, typename... Args>
 inline std::string format_error(const Options&, const char* type, const weak_ptr<T>& context_, const char* msg, Args&&... args);
@@ -85,6 +87,8 @@ public:
     bool has_text_label_prefix = false;
     bool optimize_andor = false;
     bool optimize_zero_floats = false;
+    bool optimize_jumps = false;
+    bool optimize_switch = false;
     bool entity_tracking = true;
     bool script_name_check = true;
     bool fswitch = false;
@@ -97,6 +101,7 @@ public:
     bool use_local_offsets = false;
     bool skip_cutscene = false;
     bool fsyntax_only = false;
+    bool low_memory = false;
     bool emit_ir2 = false;
     bool linear_sweep = true;
     bool relax_not = false;
@@ -110,6 +115,7 @@ public:
     bool warning_is_error = false;
     bool warn_conflict_text_label_var = false;
     bool warn_expect_var = true;
+    bool warn_entity_flow = false;
 
     // 8 bit stuff
     HeaderVersion header = HeaderVersion::None;
@@ -449,6 +455,26 @@ inline std::string format_error(const Options& opt, const char* type, const Toke
     }
 }
 
+template<typename... Args>
+inline std::string format_error(const Options& opt, const char* type, const SourceRange& context, const char* msg, Args&&... args)
+{
+    if(context.script.tstream)
+    {
+        return format_error(opt, type, TokenStream::TokenInfo(context.script.tstream->text, context.begin, context.end),
+                            msg, std::forward<Args>(args)...);
+    }
+    else if(auto linecol = context.script.linecol_from_offset(context.begin))
+    {
+        // The source text is gone, thus no excerpt of it.
+        return format_error(opt, type, nullopt, context.script.path.generic_u8string().c_str(),
+                            linecol->first, linecol->second, context.end - context.begin, msg, std::forward<Args>(args)...);
+    }
+    else
+    {
+        return format_error(opt, type, context.script, msg, std::forward<Args>(args)...);
+    }
+}
+
 template<typename... Args>
 inline std::string format_error(const Options& opt, const char* type, const SyntaxTree& context_, const char* msg, Args&&... args)
 {
@@ -83,14 +83,65 @@ auto Scope::output_type_from_node(const SyntaxTree& node) -> optional<OutputType
 
 shared_ptr<Var> Scope::var_at(size_t index) const
 {
-    size_t offset = index * 4;
-    for(auto& vpair : vars)
+    return this->vars.at_index(index);
+}
+
+shared_ptr<Var> ScopeVars::find(const string_view& name) const
+{
+    auto it = this->by_name.find(name);
+    if(it != this->by_name.end())
+        return it->second;
+    return nullptr;
+}
+
+shared_ptr<Var> ScopeVars::at_index(size_t index) const
+{
+    if(index < this->by_index.size())
+        return this->by_index[index];
+    return nullptr;
+}
+
+auto ScopeVars::emplace(const string_view& name, shared_ptr<Var> var) -> std::pair<shared_ptr<Var>, bool>
+{
+    if(auto existing = this->find(name))
+        return std::make_pair(std::move(existing), false);
+
+    this->names.emplace_back(name.data(), name.size());
+    string_view stable_name = this->names.back();
+
+    this->by_name.emplace(stable_name, var);
+
+    auto it = std::upper_bound(this->vars.begin(), this->vars.end(), var->index, [](uint32_t index, const value_type& pair) {
+        return index < pair.second->index;
+    });
+    this->vars.insert(it, value_type(stable_name, var));
+    this->add_to_index(var);
+
+    return std::make_pair(std::move(var), true);
+}
+
+void ScopeVars::reindex()
+{
+    std::stable_sort(this->vars.begin(), this->vars.end(), [](const value_type& a, const value_type& b) {
+        return a.second->index < b.second->index;
+    });
+
+    this->by_index.clear();
+    for(auto& pair : this->vars)
+        this->add_to_index(pair.second);
+}
+
+void ScopeVars::add_to_index(const shared_ptr<Var>& var)
+{
+    auto end_index = var->index + var->space_taken();
+    if(this->by_index.size() < end_index)
+        this->by_index.resize(end_index);
+
+    for(auto i = var->index; i < end_index; ++i)
     {
-        if(offset >= vpair.second->offset()
-            && offset < vpair.second->end_offset())
-            return vpair.second;
+        if(this->by_index[i] == nullptr)
+            this->by_index[i] = var;
     }
-    return nullptr;
 }
 
 auto Script::find_maximum_locals() const -> std::pair<uint32_t, uint32_t>
@@ -233,6 +284,39 @@ size_t Script::distance_from_root() const
     return (this->code_offset.value() - parent->code_offset.value()) + parent->distance_from_root();
 }
 
+void Script::release_source()
+{
+    if(this->tstream)
+    {
+        auto& text = this->tstream->text;
+        this->line_offsets.assign(text.line_offset.begin(), text.line_offset.end());
+        this->line_offsets.emplace_back(static_cast<uint32_t>(text.max_offset));
+        this->line_offsets.shrink_to_fit();
+    }
+
+    this->tree = nullptr;
+    this->tstream = nullptr;
+}
+
+auto Script::linecol_from_offset(size_t offset) const -> optional<std::pair<size_t, size_t>>
+{
+    if(this->tstream)
+    {
+        if(offset >= this->tstream->text.max_offset)
+            return nullopt;
+        return this->tstream->text.linecol_from_offset(offset);
+    }
+
+    // The last element is the size of the file, not the beginning of a line.
+    if(this->line_offsets.size() < 2 || offset >= this->line_offsets.back())
+        return nullopt;
+
+    auto it = std::upper_bound(this->line_offsets.begin(), std::prev(this->line_offsets.end()), offset);
+    size_t lineno = size_t(std::distance(this->line_offsets.begin(), it));
+    size_t colno = (offset - *std::prev(it)) + 1;
+    return std::make_pair(lineno, colno);
+}
+
 auto Script::scan_subdir() const -> Script::SubDir
 {
     auto output = insensitive_map<std::string, fs::path>();
@@ -261,30 +345,39 @@ void Script::compute_script_offsets(const std::vector<shared_ptr<Script>>& scrip
         script_ptr->code_offset.emplace(offset);
         offset += script_ptr->code_size.value();
     }
+
+    // Needs the offsets of the root scripts.
+    for(auto& script_ptr : scripts)
+    {
+        auto distance_from_base = script_ptr->root_script()->header_size() + script_ptr->distance_from_root();
+        script_ptr->layout.code_offset = script_ptr->code_offset.value();
+        script_ptr->layout.distance_from_base = static_cast<uint32_t>(distance_from_base);
+        script_ptr->layout.uses_local_offsets = script_ptr->uses_local_offsets();
+    }
 }
 
 auto Script::compute_used_objects(const std::vector<shared_ptr<Script>>& scripts) -> std::vector<std::string>
 {
     std::vector<std::string> models;
 
+    // Index of each model name in `models`.
+    // The keys refer to the names in the scripts, which are left untouched by this function.
+    insensitive_unordered_map<string_view, int32_t> models_index;
+
     for(auto& script : scripts)
     {
         for(auto& umodel : script->models)
         {
-            auto it = std::find_if(models.begin(), models.end(), [&](const std::string& m) {
-                return iequal_to()(m, umodel.first);
-            });
-
-            if(it == models.end())
+            auto it = models_index.emplace(umodel.first, int32_t(models.size()));
+            if(it.second)
             {
                 if(models.capacity() == 0)
                     models.reserve(200);
 
                 models.emplace_back(umodel.first);
-                it = models.begin() + (models.size() - 1);
             }
 
-            umodel.second = -(1 + std::distance(models.begin(), it));
+            umodel.second = -(1 + it.first->second);
         }
     }
 
@@ -654,24 +747,17 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
         }
     };
 
-    auto try_handle_set_total = [&](SyntaxTree& node, const Command& command,
-                                   const optional<const Command&>& expected,
-                                   shared_ptr<SyntaxTree>& had_node)
+    auto handle_set_total = [&](SyntaxTree& node, const Command& command, shared_ptr<SyntaxTree>& had_node)
     {
-        if(program.commands.equal(command, expected))
+        if(had_node)
         {
-            if(had_node)
-            {
-                program.error(node, "{} happens multiple times", command.name);
-                program.note(*had_node, "previously seen here");
-            }
-            else
-            {
-                had_node = node.shared_from_this();
-            }
-            return true;
+            program.error(node, "{} happens multiple times", command.name);
+            program.note(*had_node, "previously seen here");
+        }
+        else
+        {
+            had_node = node.shared_from_this();
         }
-        return false;
     };
 
     auto set_total_annotation = [&](shared_ptr<SyntaxTree>& node, int32_t count)
@@ -688,34 +774,122 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
         }
     };
 
-    auto try_handle_increase_counter = [&](SyntaxTree& node, const Command& command,
-                                           const optional<const Command&>& expected,
-                                           int32_t& counter)
+    auto handle_increase_counter = [&](SyntaxTree& node, int32_t& counter)
     {
-        if(program.commands.equal(command, expected))
+        if(node.child_count() >= 2)
         {
-            if(node.child_count() >= 2)
-            {
-                if(auto inc = node.child(1).maybe_annotation<int32_t>())
-                    counter += *inc;
-                else
-                    program.warning(node, "value is not a constant");
-            }
-            return true;
+            if(auto inc = node.child(1).maybe_annotation<int32_t>())
+                counter += *inc;
+            else
+                program.warning(node, "value is not a constant");
+        }
+    };
+
+    auto handle_assignment = [&](SyntaxTree& node)
+    {
+        auto& avar = **get_base_var_annotation(node.child(0));
+        auto& bvar = **get_base_var_annotation(node.child(1));
+
+        if(avar.entity && avar.entity != bvar.entity)
+        {
+            auto type_a = program.commands.find_entity_name(avar.entity).value();
+            auto type_b = program.commands.find_entity_name(bvar.entity).value();
+            program.error(node, "assignment of variable of type {} into one of type {}", type_b, type_a);
+        }
+
+        avar.entity = bvar.entity;
+    };
+
+    // Nodes of interest in each script, in the order they must be handled.
+    struct SpecialNode
+    {
+        enum Kind : uint8_t
+        {
+            EnterScope, ScriptName,
+            SetProgressTotal, SetTotalNumberOfMissions, SetCollectable1Total, SetMissionRespectTotal,
+            MissionPassed, CreateCollectable1, PlayerMadeProgress, AwardMissionRespect,
+            NotAllowed, StartNewScript, StartNewStreamedScript, CleoCall, CleoReturn,
+            EntityCommand, Assignment,
+        };
+
+        Kind            kind;
+        SyntaxTree*     node;
+        const Command*  command;
+    };
+
+    auto has_entity_args = [&](const SyntaxTree& node, const Command& command)
+    {
+        size_t i = 0;
+        for(auto it = std::next(node.begin()); it != node.end(); ++it, ++i)
+        {
+            if(command.arg(i).value().entity_type != 0)
+                return true;
         }
         return false;
     };
 
-    for(auto& script : scripts)
+    auto classify_command = [&](const Script& script, const SyntaxTree& node, const Command& command) -> optional<SpecialNode::Kind>
+    {
+        const bool is_child_of_custom = script.is_child_of_custom();
+        const bool is_child_of_custom_script = script.is_child_of(ScriptType::CustomScript);
+
+        auto& commands = program.commands;
+
+        if(commands.equal(command, commands.script_name))
+            return SpecialNode::ScriptName;
+        else if(commands.equal(command, commands.set_progress_total))
+            return SpecialNode::SetProgressTotal;
+        else if(commands.equal(command, commands.set_total_number_of_missions))
+            return SpecialNode::SetTotalNumberOfMissions;
+        else if(commands.equal(command, commands.set_collectable1_total))
+            return SpecialNode::SetCollectable1Total;
+        else if(commands.equal(command, commands.set_mission_respect_total))
+            return SpecialNode::SetMissionRespectTotal;
+        else if(commands.equal(command, commands.register_mission_passed)
+             || commands.equal(command, commands.register_oddjob_mission_passed))
+            return SpecialNode::MissionPassed;
+        else if(commands.equal(command, commands.create_collectable1))
+            return SpecialNode::CreateCollectable1;
+        else if(commands.equal(command, commands.player_made_progress))
+            return SpecialNode::PlayerMadeProgress;
+        else if(commands.equal(command, commands.award_player_mission_respect))
+            return SpecialNode::AwardMissionRespect;
+        else if(is_child_of_custom && commands.equal(command, commands.start_new_script))
+            return SpecialNode::NotAllowed;
+        else if(is_child_of_custom_script && commands.equal(command, commands.terminate_this_script))
+            return SpecialNode::NotAllowed;
+        else if(!is_child_of_custom_script && commands.equal(command, commands.terminate_this_custom_script))
+            return SpecialNode::NotAllowed;
+        else if(commands.equal(command, commands.start_new_script))
+            return SpecialNode::StartNewScript;
+        else if(commands.equal(command, commands.start_new_streamed_script))
+            return SpecialNode::StartNewStreamedScript;
+        else if(commands.equal(command, commands.cleo_call))
+            return SpecialNode::CleoCall;
+        else if(commands.equal(command, commands.cleo_return))
+            return SpecialNode::CleoReturn;
+        else if(program.opt.entity_tracking && has_entity_args(node, command))
+            return SpecialNode::EntityCommand;
+        else
+            return nullopt;
+    };
+
+    // Collection phase, finds the nodes of interest in each script.
+    // Reads the annotated trees only, thus the scripts are scanned in parallel.
+    std::vector<std::vector<SpecialNode>> special_nodes(scripts.size());
+
+    parallel_for_loop(size_t(0), scripts.size(), [&](size_t i)
     {
-        script->tree->depth_first([&](SyntaxTree& node)
+        auto& script = *scripts[i];
+        auto& output = special_nodes[i];
+
+        script.tree->depth_first([&](SyntaxTree& node)
         {
             switch(node.type())
             {
                 case NodeType::Scope:
                 {
-                    // scope checking already happened at this point, so no need for handling entering/exiting
-                    last_scope_entered = node.annotation<shared_ptr<Scope>>();
+                    output.push_back(SpecialNode { SpecialNode::EnterScope, &node, nullptr });
                     return true;
                 }
 
@@ -723,61 +897,9 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
                 {
                     if(auto opt_command = node.maybe_annotation<std::reference_wrapper<const Command>>())
                     {
-                        const bool is_child_of_custom = script->is_child_of_custom();
-                        const bool is_child_of_custom_script = script->is_child_of(ScriptType::CustomScript);
-
                         auto& command = (*opt_command).get();
-                        if(program.commands.equal(command, program.commands.script_name))
-                        {
-                            handle_script_name(node, command);
-                        }
-                        else if(try_handle_set_total(node, command, program.commands.set_progress_total, node_set_progress_total)
-                             || try_handle_set_total(node, command, program.commands.set_total_number_of_missions, node_set_total_number_of_missions)
-                             || try_handle_set_total(node, command, program.commands.set_collectable1_total, node_set_collectable1_total)
-                             || try_handle_set_total(node, command, program.commands.set_mission_respect_total, node_set_mission_respect_total))
-                            {}
-                        else if(program.commands.equal(command, program.commands.register_mission_passed)
-                             || program.commands.equal(command, program.commands.register_oddjob_mission_passed))
-                            { ++count_mission_passed; }
-                        else if(program.commands.equal(command, program.commands.create_collectable1))
-                            { ++count_collectable1; }
-                        else if(try_handle_increase_counter(node, command, program.commands.player_made_progress, count_progress)
-                             || try_handle_increase_counter(node, command, program.commands.award_player_mission_respect, count_respect))
-                            {}
-                        else if(is_child_of_custom && program.commands.equal(command, program.commands.start_new_script))
-                        {
-                            program.error(node, "this command is not allowed in {} scripts", to_string(script->type));
-                        }
-                        else if(is_child_of_custom_script
-                            && program.commands.equal(command, program.commands.terminate_this_script))
-                        {
-                            program.error(node, "this command is not allowed in {} scripts", to_string(script->type));
-                        }
-                        else if(!is_child_of_custom_script
-                            && program.commands.equal(command, program.commands.terminate_this_custom_script))
-                        {
-                            program.error(node, "this command is not allowed in {} scripts", to_string(script->type));
-                        }
-                        else if(program.commands.equal(command, program.commands.start_new_script))
-                        {
-                            handle_start_new_script(node, command);
-                        }
-                        else if(program.commands.equal(command, program.commands.start_new_streamed_script))
-                        {
-                            handle_start_new_streamed_script(node, command);
-                        }
-                        else if(program.commands.equal(command, program.commands.cleo_call))
-                        {
-                            handle_cleo_call(node, command);
-                        }
-                        else if(program.commands.equal(command, program.commands.cleo_return))
-                        {
-                            handle_cleo_return(node, command);
-                        }
-                        else
-                        {
-                            handle_entity_command(node, command);
-                        }
+                        if(auto kind = classify_command(script, node, command))
+                            output.push_back(SpecialNode { *kind, &node, &command });
                     }
                     return false;
                 }
@@ -793,22 +915,8 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
                         auto& command = node.annotation<std::reference_wrapper<const Command>>().get();
                         if(program.commands.is_alternator(command, program.commands.set))
                         {
-                            auto opt_avar = get_base_var_annotation(a);
-                            auto opt_bvar = get_base_var_annotation(b);
-                            if(opt_avar && opt_bvar)
-                            {
-                                auto& avar = **opt_avar;
-                                auto& bvar = **opt_bvar;
-
-                                if(avar.entity && avar.entity != bvar.entity)
-                                {
-                                    auto type_a = program.commands.find_entity_name(avar.entity).value();
-                                    auto type_b = program.commands.find_entity_name(bvar.entity).value();
-                                    program.error(node, "assignment of variable of type {} into one of type {}", type_b, type_a);
-                                }
-
-                                avar.entity = bvar.entity;
-                            }
+                            if(get_base_var_annotation(a) && get_base_var_annotation(b))
+                                output.push_back(SpecialNode { SpecialNode::Assignment, &node, &command });
                         }
                     }
 
@@ -819,6 +927,75 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
                     return true;
             }
         });
+    });
+
+    // Reduction phase, handles the nodes of interest in the order they appear in the scripts.
+    for(size_t i = 0; i < scripts.size(); ++i)
+    {
+        auto& script = *scripts[i];
+
+        for(auto& special : special_nodes[i])
+        {
+            auto& node = *special.node;
+
+            switch(special.kind)
+            {
+                case SpecialNode::EnterScope:
+                    // scope checking already happened at this point, so no need for handling entering/exiting
+                    last_scope_entered = node.annotation<shared_ptr<Scope>>();
+                    break;
+                case SpecialNode::ScriptName:
+                    handle_script_name(node, *special.command);
+                    break;
+                case SpecialNode::SetProgressTotal:
+                    handle_set_total(node, *special.command, node_set_progress_total);
+                    break;
+                case SpecialNode::SetTotalNumberOfMissions:
+                    handle_set_total(node, *special.command, node_set_total_number_of_missions);
+                    break;
+                case SpecialNode::SetCollectable1Total:
+                    handle_set_total(node, *special.command, node_set_collectable1_total);
+                    break;
+                case SpecialNode::SetMissionRespectTotal:
+                    handle_set_total(node, *special.command, node_set_mission_respect_total);
+                    break;
+                case SpecialNode::MissionPassed:
+                    ++count_mission_passed;
+                    break;
+                case SpecialNode::CreateCollectable1:
+                    ++count_collectable1;
+                    break;
+                case SpecialNode::PlayerMadeProgress:
+                    handle_increase_counter(node, count_progress);
+                    break;
+                case SpecialNode::AwardMissionRespect:
+                    handle_increase_counter(node, count_respect);
+                    break;
+                case SpecialNode::NotAllowed:
+                    program.error(node, "this command is not allowed in {} scripts", to_string(script.type));
+                    break;
+                case SpecialNode::StartNewScript:
+                    handle_start_new_script(node, *special.command);
+                    break;
+                case SpecialNode::StartNewStreamedScript:
+                    handle_start_new_streamed_script(node, *special.command);
+                    break;
+                case SpecialNode::CleoCall:
+                    handle_cleo_call(node, *special.command);
+                    break;
+                case SpecialNode::CleoReturn:
+                    handle_cleo_return(node, *special.command);
+                    break;
+                case SpecialNode::EntityCommand:
+                    handle_entity_command(node, *special.command);
+                    break;
+                case SpecialNode::Assignment:
+                    handle_assignment(node);
+                    break;
+                default:
+                    Unreachable();
+            }
+        }
     }
 
     set_total_annotation(node_set_collectable1_total, count_collectable1);
@@ -862,7 +1039,7 @@ void Script::compute_scope_outputs(const SymTable& symbols, ProgramContext& prog
                         {
                             if((*it)->type() == NodeType::Text)
                             {
-                                auto opt_match = Miss2Identifier::match((*it)->text(), program.opt);
+                                auto opt_match = (*it)->identifier((*it)->text(), program.opt);
                                 if(opt_match)
                                 {
                                     string_view varname;
@@ -936,6 +1113,8 @@ void Script::fix_call_scope_variables(ProgramContext& program)
                 assert(var_index >= program.opt.mission_var_begin);
                 var_index -= program.opt.mission_var_begin;
             }
+
+            scope->vars.reindex();
         }
     }
 }
@@ -20,7 +20,17 @@ class Script : public std::enable_shared_from_this<Script>
 public:
     using SubDir = insensitive_map<std::string, fs::path>;
 
+    /// Offset properties of a script, to reference its labels without walking the tree of required scripts.
+    struct Layout
+    {
+        uint32_t    code_offset = 0;            //< Same as `code_offset`.
+        uint32_t    distance_from_base = 0;     //< Offset of the code of this script relative to `root_script()->base`.
+        bool        uses_local_offsets = false; //< Same as `uses_local_offsets()`.
+    };
+
 public:
+    Script(const Script&) = delete;
+
     /// \returns `nullptr` on failure and populates `program` with errors, otherwise the script object.
     static shared_ptr<Script> create(fs::path path, ScriptType type, ProgramContext& program);
 
@@ -46,7 +56,7 @@ public:
     /// \warning this method is not exactly thread-safe.
     void fix_call_scope_variables(ProgramContext& program);
 
-    /// Calculates and sets the `offset` field for all the scripts in the `scripts` vector.
+    /// Calculates and sets the `offset` and `layout` fields for all the scripts in the `scripts` vector.
     /// \warning this method is not thread-safe.
     static void compute_script_offsets(const std::vector<shared_ptr<Script>>& scripts, const MultiFileHeaderList&);
 
@@ -56,6 +66,8 @@ public:
     static auto compute_used_objects(const std::vector<shared_ptr<Script>>& scripts)->std::vector<std::string>;
 
     /// Handles things such as procedure calling and entity information, on which the order of finding is important.
+    ///
+    /// The scripts are scanned in parallel, but the findings are handled serially in the order of `scripts`.
     /// \warning this method is not thread-safe.
     static void handle_special_commands(const std::vector<shared_ptr<Script>>&, SymTable&, ProgramContext&);
 
@@ -90,6 +102,17 @@ public:
     /// \returns the code offset from the root script to this script.
     size_t distance_from_root() const;
 
+    /// Drops the token stream and syntax tree of this script, keeping only a table of line offsets
+    /// of the source file, so diagnostics may still be located.
+    ///
+    /// After this, `tstream` and `tree` are null, and any pointer into the tree is dangling.
+    /// \warning this method is not thread-safe.
+    void release_source();
+
+    /// Gets the (lineno, colno) (1-based) of the specified byte offset in the source file of this script.
+    /// \note works both before and after `release_source`.
+    optional<std::pair<size_t, size_t>> linecol_from_offset(size_t offset) const;
+
     /// Finds the highest local variable indices used by general scopes (.first) and call scopes (.second).
     /// \note also searches in children scripts.
     /// \note if the last local index used was e.g. 0+, then this returns 1+. If no local was used, returns 0.
@@ -112,20 +135,22 @@ public:
     /// Finds whether the unknown model `name` was used in this script, and its usage index.
     optional<int32_t> find_model(const string_view& name) const
     {
-        auto it = std::find_if(models.begin(), models.end(), [&](const auto& mpair) {
-            return iequal_to()(mpair.first, name);
-        });
-        if(it != models.end())
-            return it->second;
+        auto it = this->models_index.find(name);
+        if(it != this->models_index.end())
+            return this->models[it->second].second;
         return nullopt;
     }
 
     /// Does the same as `find_model`, except it adds the model if none was found.
     int32_t add_or_find_model(const string_view& name)
     {
-        if(auto opt = this->find_model(name))
-            return *opt;
-        return this->models.emplace(models.end(), name.to_string(), models.size())->second;
+        auto it = this->models_index.find(name);
+        if(it != this->models_index.end())
+            return this->models[it->second].second;
+
+        auto& model = *this->models.emplace(models.end(), name.to_string(), models.size());
+        this->models_index.emplace(model.first, uint32_t(models.size() - 1));
+        return model.second;
     }
 
     /// Finds the unknown model index at position `i`.
@@ -137,7 +162,7 @@ public:
 public:
     const fs::path          path;
     const ScriptType        type;
-    const shared_ptr<TokenStream> tstream;
+    shared_ptr<TokenStream> tstream;
     shared_ptr<SyntaxTree>  tree;
 
     shared_ptr<Label>       top_label;      //< Label on the very top of the script, before any command.
@@ -166,6 +191,10 @@ public:
     /// This value is made available just before the AST annotation step.
     optional<uint16_t>      streamed_id;
 
+    /// The offset properties of this script.
+    /// This value is made available by `compute_script_offsets`, before that it's all zeros.
+    Layout                  layout;
+
     /// All the scopes within this script.
     std::vector<shared_ptr<Scope>> scopes;
 
@@ -174,9 +203,17 @@ public:
     weak_ptr<const Script>              parent_script;      //< Parent of required script.
 
 private:
+    /// Offset of the beginning of each line in the source file, plus the size of the file.
+    /// This value is made available after `release_source`.
+    std::vector<uint32_t> line_offsets;
+
     /// List of used models referenced by this script.
     /// This value is made available after the AST annotation step.
-    std::vector<std::pair<std::string, int32_t>> models;
+    /// A deque, so the names stay at the same address while models are added.
+    std::deque<std::pair<std::string, int32_t>> models;
+
+    /// Position of each model name in `models`. The keys refer to the names in there.
+    insensitive_unordered_map<string_view, uint32_t> models_index;
 
 private:
     // Use Script::create or Script::from_subdir instead.
@@ -187,6 +224,16 @@ private:
     }
 };
 
+/// Range of bytes in the source file of a script.
+///
+/// Unlike syntax tree nodes, may still be located after `Script::release_source`.
+struct SourceRange
+{
+    const Script&   script;
+    size_t          begin;
+    size_t          end;
+};
+
 /// Information about a previously declared variable.
 struct Var
 {
@@ -197,6 +244,10 @@ struct Var
     uint32_t                  index; ///< Variable index (not offset). \note this value is not well-defined until the ir-generation step.
     const optional<uint32_t>  count; ///< If an array, the number of elements of it.
 
+    /// Whether the name of this variable also names a constant or label, as seen by `Commands::match`.
+    /// Zero means not computed yet. \warning Computed lazily by any thread, though always to the same value.
+    mutable std::atomic<uint8_t> name_clash { 0 };
+
     explicit Var(weak_ptr<const SyntaxTree> where, bool global, VarType type, uint32_t index, optional<uint32_t> count)
         : where(std::move(where)), entity(0), global(global), type(type), index(index), count(count)
     {}
@@ -212,7 +263,7 @@ struct Var
     static uint32_t space_taken(VarType type, size_t count = 1);
 
     /// \returns the byte offset (index*4) on which this variable is in memory.
-    uint32_t offset() {
+    uint32_t offset() const {
         return index * 4;
     }
 
@@ -227,6 +278,48 @@ struct Var
     }
 };
 
+/// Variables of a scope, stored contiguously and ordered by index.
+///
+/// Scopes usually hold a few dozen variables, so a flat array plus a name index is cheaper than a tree.
+class ScopeVars
+{
+public:
+    using value_type     = std::pair<string_view, shared_ptr<Var>>;
+    using const_iterator = small_vector<value_type, 32>::const_iterator;
+
+    ScopeVars() = default;
+    ScopeVars(const ScopeVars&) = delete;
+    ScopeVars(ScopeVars&&) = default;
+
+    const_iterator begin() const { return this->vars.begin(); }
+    const_iterator end() const   { return this->vars.end(); }
+    size_t size() const          { return this->vars.size(); }
+    bool empty() const           { return this->vars.empty(); }
+
+    /// Finds the variable named `name`.
+    shared_ptr<Var> find(const string_view& name) const;
+
+    /// Finds the variable which occupies the specified local index.
+    shared_ptr<Var> at_index(size_t index) const;
+
+    /// Adds the variable `var` named `name`, unless there's a variable with such name already.
+    ///
+    /// \returns the variable named `name` and whether it was just added.
+    std::pair<shared_ptr<Var>, bool> emplace(const string_view& name, shared_ptr<Var> var);
+
+    /// Must be called after changing `Var::index` of any variable in here.
+    void reindex();
+
+private:
+    void add_to_index(const shared_ptr<Var>&);
+
+private:
+    std::deque<std::string>                                     names;      //< Storage for names (addresses never change).
+    small_vector<value_type, 32>                                vars;       //< Ordered by `Var::index`.
+    insensitive_unordered_map<string_view, shared_ptr<Var>>     by_name;
+    std::vector<shared_ptr<Var>>                                by_index;   //< Variable at each local index (may be null).
+};
+
 /// Scope information.
 class Scope
 {
@@ -235,8 +328,8 @@ public:
     using OutputVector = std::vector<std::pair<OutputType, weak_ptr<Var>>>;
 
 public:
-    insensitive_map<std::string, shared_ptr<Var>>   vars;       //< The variables in this scope.
-    
+    ScopeVars                                       vars;       //< The variables in this scope.
+
     explicit Scope(weak_ptr<SyntaxTree> tree) :
         tree(std::move(tree))
     {}
@@ -263,9 +356,10 @@ struct Label
     weak_ptr<const Script>    script;       //< The script of this label (weak to avoid circular reference)
     weak_ptr<const SyntaxTree>where;        //< Where this label was declared (may be expired() for unknown)
     optional<uint32_t>        code_position;//< Relative to `script->code_offset`.
+    const Script::Layout*     layout;       //< Layout of `script`, to compute references without locking `script`.
 
     explicit Label(weak_ptr<const SyntaxTree> where, shared_ptr<const Scope> scope, shared_ptr<const Script> script)
-        : where(std::move(where)), scope(std::move(scope)), script(std::move(script))
+        : scope(std::move(scope)), script(script), where(std::move(where)), layout(std::addressof(script->layout))
     {}
 
     explicit Label(shared_ptr<const Scope> scope, shared_ptr<const Script> script)
@@ -273,24 +367,11 @@ struct Label
     {}
 
     explicit Label(shared_ptr<const Scope> scope, shared_ptr<const Script> script, uint32_t code_position)
-        : scope(std::move(scope)), script(std::move(script)), code_position(code_position)
+        : scope(std::move(scope)), script(script), code_position(code_position), layout(std::addressof(script->layout))
     {}
 
     /// \returns whether a branch from `other_script` into this label is possible.
     bool may_branch_from(const Script& other_script, ProgramContext& program) const;
-
-    ///  \returns the global offset for this label.
-    uint32_t offset() const
-    {
-        return script.lock()->code_offset.value() + this->code_position.value();
-    }
-
-    /// \returns the local offset for this label relative to `script->root_script()->base`.
-    uint32_t distance_from_base() const
-    {
-        auto script = this->script.lock();
-        return script->root_script()->header_size() + script->distance_from_root() + this->code_position.value();
-    }
 };
 
 inline const char* to_string(ScriptType type)
@@ -7,6 +7,7 @@
 
 #include <cstdint>
 #include <climits>
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
 #include <stdexcept>
@@ -14,6 +15,7 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <deque>
 #include <stack>
 #include <map>
 #include <set>
@@ -21,6 +23,12 @@
 #include <numeric>
 #include <iterator>
 #include <atomic>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
 #include <cppformat/format.h>
 #include "cpp/any.hpp"
 #include "cpp/variant.hpp"
@@ -57,6 +65,9 @@ using insensitive_map = std::map<Key, Value, iless>;
 template<typename Key>
 using insensitive_set = std::set<Key, iless>;
 
+template<typename Key, typename Value>
+using insensitive_unordered_map = std::unordered_map<Key, Value, ihash, iequal_to>;
+
 class SyntaxTree;
 class ProgramContext;
 class Options;
@@ -99,6 +110,35 @@ inline void for_loop(IndexType begin, IndexType end, Functor functor)
         functor(i);
 }
 
+/// Calls `functor(i)` for each `i` in [begin, end), spreading the iterations across the hardware threads.
+///
+/// \warning `functor` must be safe to be called concurrently.
+template<typename IndexType, typename Functor>
+inline void parallel_for_loop(IndexType begin, IndexType end, Functor functor)
+{
+    size_t count = static_cast<size_t>(end - begin);
+    size_t num_threads = (std::min)(count, size_t((std::max)(1u, std::thread::hardware_concurrency())));
+
+    if(num_threads <= 1)
+        return for_loop(begin, end, std::move(functor));
+
+    std::atomic<size_t> next_i(0);
+    auto worker = [&] {
+        for(size_t i; (i = next_i++) < count; )
+            functor(static_cast<IndexType>(begin + i));
+    };
+
+    std::vector<std::future<void>> tasks;
+    tasks.reserve(num_threads - 1);
+    for(size_t t = 1; t < num_threads; ++t)
+        tasks.emplace_back(std::async(std::launch::async, worker));
+
+    worker();
+
+    for(auto& task : tasks)
+        task.get();
+}
+
 inline std::string escape_string(const string_view& string, char quotes, bool push_quotes)
 {
     std::string result;
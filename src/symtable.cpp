@@ -40,9 +40,8 @@ optional<shared_ptr<Var>> SymTable::find_var(const string_view& name, const shar
 
     if(current_scope)
     {
-        auto it = current_scope->vars.find(name);
-        if(it != current_scope->vars.end())
-            return it->second;
+        if(auto var = current_scope->vars.find(name))
+            return var;
     }
 
     return nullopt;
@@ -85,22 +84,36 @@ optional<const UserConstant&> SymTable::find_constant(const string_view& name) c
 
 auto IncluderTable::script_type(const string_view& filename) const -> optional<ScriptType>
 {
-    auto searcher = [&](const std::string& other) {
-        return iequal_to()(other, filename);
-    };
-
-    if(std::any_of(this->extfiles.begin(), this->extfiles.end(), searcher))
-        return ScriptType::MainExtension;
-    else if(std::any_of(this->subscript.begin(), this->subscript.end(), searcher))
-        return ScriptType::Subscript;
-    else if(std::any_of(this->mission.begin(), this->mission.end(), searcher))
-        return ScriptType::Mission;
-    else if(std::any_of(this->streamed.begin(), this->streamed.end(), searcher))
-        return ScriptType::StreamedScript;
-    else if(std::any_of(this->required.begin(), this->required.end(), searcher))
-        return ScriptType::Required;
-    else
+    auto it = this->types_index.find(filename);
+    if(it == this->types_index.end())
         return nullopt;
+
+    // The same filename may have been (wrongly) seen as more than one type, prefer
+    // the types in the following order.
+    for(auto type : { ScriptType::MainExtension, ScriptType::Subscript, ScriptType::Mission,
+                      ScriptType::StreamedScript, ScriptType::Required })
+    {
+        if(it->second & type_bit(type))
+            return type;
+    }
+
+    Unreachable();
+}
+
+void IncluderTable::index_script(ScriptType type, const string_view& filename)
+{
+    this->type_mask(filename) |= type_bit(type);
+}
+
+uint8_t& IncluderTable::type_mask(const string_view& filename)
+{
+    auto it = this->types_index.find(filename);
+    if(it == this->types_index.end())
+    {
+        this->types_names.emplace_back(filename.data(), filename.size());
+        it = this->types_index.emplace(this->types_names.back(), 0).first;
+    }
+    return it->second;
 }
 
 bool IncluderTable::add_script(ScriptType type, const SyntaxTree& command, ProgramContext& program)
@@ -151,6 +164,7 @@ bool IncluderTable::add_script(ScriptType type, const SyntaxTree& command, Progr
             }
 
             refvector.get().emplace_back(script_name);
+            this->index_script(type, script_name);
             return true;
         }
     }
@@ -158,22 +172,19 @@ bool IncluderTable::add_script(ScriptType type, const SyntaxTree& command, Progr
 
 optional<shared_ptr<Var>> SymTable::highest_global_var() const
 {
-    auto fn_comp = [](const auto& apair, const auto& bpair)
-    {
-        const shared_ptr<Var>& a = apair.second;
-        const shared_ptr<Var>& b = bpair.second;
-        if(a->index < b->index)
-            return true;
-        else if(a->index != b->index)
-            return false;
-        else
-            return a->space_taken() < b->space_taken();
-    };
-
-    auto it = std::max_element(this->global_vars.begin(), this->global_vars.end(), fn_comp);
-    if(it == this->global_vars.end())
+    if(this->highest_global == nullptr)
         return nullopt;
-    return it->second;
+    return this->highest_global;
+}
+
+void SymTable::track_global_var(const shared_ptr<Var>& var)
+{
+    auto& highest = this->highest_global;
+    if(highest == nullptr || highest->index < var->index
+    || (highest->index == var->index && highest->space_taken() < var->space_taken()))
+    {
+        highest = var;
+    }
 }
 
 void SymTable::build_script_table(const std::vector<shared_ptr<Script>>& scripts)
@@ -191,50 +202,38 @@ void SymTable::merge(SymTable&& t2, ProgramContext& program)
 {
     auto& t1 = *this;
 
-    decltype(labels) int_labels;
-    decltype(global_vars) int_gvars;
-    decltype(constants) int_constants;
-
-    // finds items that are common in both
-    std::set_intersection(t1.labels.begin(), t1.labels.end(),
-        t2.labels.begin(), t2.labels.end(),
-        std::inserter(int_labels, int_labels.begin()),
-        t1.labels.value_comp());
-
-    // finds items that are common in both
-    std::set_intersection(t1.global_vars.begin(), t1.global_vars.end(),
-        t2.global_vars.begin(), t2.global_vars.end(),
-        std::inserter(int_gvars, int_gvars.begin()),
-        t1.global_vars.value_comp());
-
-    // finds items that are common in both
-    std::set_intersection(t1.constants.begin(), t1.constants.end(),
-        t2.constants.begin(), t2.constants.end(),
-        std::inserter(int_constants, int_constants.begin()),
-        t1.constants.value_comp());
-
-    for(auto& kv : int_labels)
+    // Only the incoming symbols are probed against the accumulated table, so merging
+    // script by script is linear on the number of symbols of the incoming table.
+    // Both tables are sorted by name, thus diagnostics come out in name order.
+
+    for(auto& kv : t2.labels)
     {
-        auto where1 = t1.labels.find(kv.first)->second->where;
-        auto where2 = t2.labels.find(kv.first)->second->where;
-        program.error(where2, "label name exists already");
-        program.note(where1, "previously defined here");
+        auto it = t1.labels.find(kv.first);
+        if(it != t1.labels.end())
+        {
+            program.error(kv.second->where, "label name exists already");
+            program.note(it->second->where, "previously defined here");
+        }
     }
 
-    for(auto& kv : int_gvars)
+    for(auto& kv : t2.global_vars)
     {
-        auto where1 = t1.global_vars.find(kv.first)->second->where;
-        auto where2 = t2.global_vars.find(kv.first)->second->where;
-        program.error(where2, "variable name exists already");
-        program.note(where1, "previously defined here");
+        auto it = t1.global_vars.find(kv.first);
+        if(it != t1.global_vars.end())
+        {
+            program.error(kv.second->where, "variable name exists already");
+            program.note(it->second->where, "previously defined here");
+        }
     }
 
-    for(auto& kv : int_constants)
+    for(auto& kv : t2.constants)
     {
-        auto where1 = t1.constants.find(kv.first)->second.where;
-        auto where2 = t2.constants.find(kv.first)->second.where;
-        program.error(where2, "user constant exists already");
-        program.note(where1, "previously defined here");
+        auto it = t1.constants.find(kv.first);
+        if(it != t1.constants.end())
+        {
+            program.error(kv.second.where, "user constant exists already");
+            program.note(it->second.where, "previously defined here");
+        }
     }
 
     // All error conditions checked, perform actual merge
@@ -248,8 +247,12 @@ void SymTable::merge(SymTable&& t2, ProgramContext& program)
     t1.labels.insert(std::make_move_iterator(t2.labels.begin()),
         std::make_move_iterator(t2.labels.end()));
 
-    t1.global_vars.insert(std::make_move_iterator(t2.global_vars.begin()),
-        std::make_move_iterator(t2.global_vars.end()));
+    for(auto& kv : t2.global_vars)
+    {
+        auto pair = t1.global_vars.insert(std::move(kv));
+        if(pair.second)
+            t1.track_global_var(pair.first->second);
+    }
 
     t1.local_scopes.reserve(t1.local_scopes.size() + t2.local_scopes.size());
     std::move(t2.local_scopes.begin(), t2.local_scopes.end(), std::back_inserter(t1.local_scopes));
@@ -282,6 +285,9 @@ void IncluderTable::merge(IncluderTable&& t2, ProgramContext& program)
     check_file_conflicts(ScriptType::Mission, t2.mission);
     check_file_conflicts(ScriptType::StreamedScript, t2.streamed);
 
+    for(auto& kv : t2.types_index)
+        t1.type_mask(kv.first) |= kv.second;
+
     t1.required.reserve(t1.required.size() + t2.required.size());
     std::move(t2.required.begin(), t2.required.end(), std::back_inserter(t1.required));
 
@@ -303,26 +309,43 @@ void IncluderTable::merge(IncluderTable&& t2, ProgramContext& program)
 
 void SymTable::check_scope_collisions(ProgramContext& program) const
 {
-    // XXX this method would probably benefit from parallelism
+    // (local var, global var) pairs with the same name, for each scope.
+    using Collisions = std::vector<std::pair<shared_ptr<Var>, shared_ptr<Var>>>;
 
-    decltype(global_vars) int_vars;
+    insensitive_unordered_map<string_view, shared_ptr<Var>> global_index;
+    global_index.reserve(this->global_vars.size());
+    for(auto& kv : this->global_vars)
+        global_index.emplace(kv.first, kv.second);
 
-    for(auto& scope : this->local_scopes)
+    std::vector<Collisions> collisions(this->local_scopes.size());
+
+    parallel_for_loop(size_t(0), this->local_scopes.size(), [&](size_t i)
     {
-        int_vars.clear();
+        std::vector<std::pair<string_view, shared_ptr<Var>>> int_vars;
 
         // finds items that are common in both
-        std::set_intersection(global_vars.begin(), global_vars.end(),
-            scope->vars.begin(), scope->vars.end(),
-            std::inserter(int_vars, int_vars.begin()),
-            global_vars.value_comp());
+        for(auto& kv : this->local_scopes[i]->vars)
+        {
+            if(global_index.count(kv.first))
+                int_vars.emplace_back(kv);
+        }
+
+        // diagnostics are ordered by name
+        std::sort(int_vars.begin(), int_vars.end(), [](const auto& a, const auto& b) {
+            return iless()(a.first, b.first);
+        });
 
         for(auto& kv : int_vars)
+            collisions[i].emplace_back(kv.second, global_index.find(kv.first)->second);
+    });
+
+    // Diagnostics are emitted serially, in the order of the scopes.
+    for(auto& scope_collisions : collisions)
+    {
+        for(auto& pair : scope_collisions)
         {
-            auto where1 = global_vars.find(kv.first)->second->where;
-            auto where2 = scope->vars.find(kv.first)->second->where;
-            program.error(where2, "variable name exists already");
-            program.note(where1, "previously defined here");
+            program.error(pair.first->where, "variable name exists already");
+            program.note(pair.second->where, "previously defined here");
         }
     }
 }
@@ -332,8 +355,7 @@ void SymTable::check_constant_collisions(ProgramContext& program) const
     if(!program.opt.constant_checks)
         return;
 
-    // XXX this method would probably benefit from parallelism
-
+    // All the lookups below are read-only, thus the scopes may be checked in parallel.
     auto has_constant_with_name = [&](const string_view& name) {
         return program.commands.find_constant_all(name) || program.is_model_from_ide(name);
     };
@@ -344,13 +366,26 @@ void SymTable::check_constant_collisions(ProgramContext& program) const
             program.error(kv.second->where, "variable name exists already as a string constant");
     }
 
-    for(auto& scope : this->local_scopes)
+    std::vector<std::vector<std::pair<string_view, shared_ptr<Var>>>> bad_vars(this->local_scopes.size());
+
+    parallel_for_loop(size_t(0), this->local_scopes.size(), [&](size_t i)
     {
-        for(auto& kv : scope->vars)
+        for(auto& kv : this->local_scopes[i]->vars)
         {
             if(this->find_constant(kv.first) || has_constant_with_name(kv.first))
-                program.error(kv.second->where, "variable name exists already as a string constant");
+                bad_vars[i].emplace_back(kv);
         }
+
+        // diagnostics are ordered by name
+        std::sort(bad_vars[i].begin(), bad_vars[i].end(), [](const auto& a, const auto& b) {
+            return iless()(a.first, b.first);
+        });
+    });
+
+    for(auto& scope_bad_vars : bad_vars)
+    {
+        for(auto& kv : scope_bad_vars)
+            program.error(kv.second->where, "variable name exists already as a string constant");
     }
 
     for(auto& kv : this->constants)
@@ -423,9 +458,8 @@ void IncluderTable::scan_for_includers(const Script& script, ProgramContext& pro
 
 void SymTable::scan_symbols(Script& script, ProgramContext& program)
 {
-    std::function<bool(SyntaxTree&)> walker;
-
     shared_ptr<Scope> current_scope;
+    std::vector<shared_ptr<Scope>> outer_scopes; //< current_scope before entering each Scope node.
     shared_ptr<SyntaxTree> next_scoped_label;
     size_t global_index = 0, local_index = 0;
 
@@ -469,7 +503,7 @@ void SymTable::scan_symbols(Script& script, ProgramContext& program)
         node.set_annotation(std::move(label_ptr));
     };
 
-    walker = [&](SyntaxTree& node)
+    auto walker = [&](SyntaxTree& node)
     {
         switch(node.type())
         {
@@ -496,9 +530,7 @@ void SymTable::scan_symbols(Script& script, ProgramContext& program)
 
             case NodeType::Scope:
             {
-                auto guard = make_scope_guard([&, old_current_scope = current_scope] {
-                    current_scope = old_current_scope;
-                });
+                outer_scopes.emplace_back(current_scope);
 
                 if(!current_scope)
                 {
@@ -519,9 +551,8 @@ void SymTable::scan_symbols(Script& script, ProgramContext& program)
                     next_scoped_label = nullptr;
                 }
 
-                node.child(0).depth_first(std::ref(walker));
-                node.set_annotation(std::move(current_scope));
-                return false;
+                // the scope is left in `leave_scope`
+                return true;
             }
 
             case NodeType::VAR_INT: case NodeType::LVAR_INT:
@@ -548,9 +579,18 @@ void SymTable::scan_symbols(Script& script, ProgramContext& program)
                     return false;
                 }
 
-                auto& target = global? this->global_vars : current_scope->vars;
                 auto& index = global? global_index : local_index;
 
+                auto emplace_var = [&](const string_view& name, shared_ptr<Var> var) -> std::pair<shared_ptr<Var>, bool>
+                {
+                    if(!global)
+                        return current_scope->vars.emplace(name, std::move(var));
+                    auto pair = this->global_vars.emplace(name, std::move(var));
+                    if(pair.second)
+                        this->track_global_var(pair.first->second);
+                    return std::make_pair(pair.first->second, pair.second);
+                };
+
                 size_t max_index = [&] {
                     if(global)
                         return uint32_t(65536 / 4);
@@ -562,7 +602,7 @@ void SymTable::scan_symbols(Script& script, ProgramContext& program)
 
                 for(auto& varnode : node)
                 {
-                    if(auto opt_token = Miss2Identifier::match(varnode->text(), program.opt))
+                    if(auto opt_token = varnode->identifier(varnode->text(), program.opt))
                     {
                         auto name = opt_token->identifier;
 
@@ -606,8 +646,8 @@ void SymTable::scan_symbols(Script& script, ProgramContext& program)
                             continue;
                         }
 
-                        auto pair = target.emplace(name, std::make_shared<Var>(varnode, global, vartype, index, count));
-                        auto var = pair.first->second;
+                        auto pair = emplace_var(name, std::make_shared<Var>(varnode, global, vartype, index, count));
+                        auto var = pair.first;
 
                         if(!pair.second)
                         {
@@ -666,29 +706,165 @@ void SymTable::scan_symbols(Script& script, ProgramContext& program)
         }
     };
 
-    script.tree->depth_first(std::ref(walker));
+    auto leave_scope = [&](SyntaxTree& node)
+    {
+        if(node.type() == NodeType::Scope)
+        {
+            node.set_annotation(std::move(current_scope));
+            current_scope = std::move(outer_scopes.back());
+            outer_scopes.pop_back();
+        }
+    };
+
+    script.tree->depth_first(std::ref(walker), std::ref(leave_scope));
 }
 
-void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
+namespace
+{
+/// Annotates the statements of a script. See `Script::annotate_tree`.
+///
+/// The state scoped by compound statements (the current scope, whether in a condition list,
+/// the loop depth) lives in a stack of frames, one for each node whose childs are being visited,
+/// so leaving a node restores the state of its parent.
+struct TreeAnnotator
 {
-    const Commands& commands = program.commands;
+    /// State of the traversal as seen by a node.
+    struct Context
+    {
+        shared_ptr<Scope> current_scope;
+        bool     is_condition_block = false;
+        uint32_t loop_depth_continue = 0;
+        uint32_t loop_depth_break = 0;
+    };
+
+    /// A node whose childs are being visited.
+    struct Frame
+    {
+        SyntaxTree* node;
+        size_t      next_child; //< Index of the next child of `node` to be visited.
+        Context     context;    //< Context seen by the childs of `node`.
+    };
+
+    /// A SWITCH statement whose body is being visited.
+    struct SwitchState
+    {
+        SyntaxTree*                  node;
+        const Command*               case_command;
+        std::vector<int32_t>         case_values;
+        bool                         had_default = false;
+        bool                         last_statement_was_break = true;
+        shared_ptr<const SyntaxTree> last_case;
+    };
 
-    std::function<bool(SyntaxTree&)> walker;
+    Script&             script;
+    const SymTable&     symbols;
+    ProgramContext&     program;
+    const Commands&     commands;
 
     bool had_mission_start = false;
     bool had_mission_end   = false;
     bool had_script_start  = false;
     bool had_script_end    = false;
-    
-    shared_ptr<Scope> current_scope;
+
     shared_ptr<Label> cutscene_skip;
-    bool is_condition_block = false;
     uint32_t num_statements = 0;
-    uint32_t num_directives = 0;
-    uint32_t loop_depth_continue = 0;
-    uint32_t loop_depth_break = 0;
 
-    auto directive_info = [&](NodeType type)
+    Context                  ctx;       //< Context of the node being visited.
+    std::vector<Frame>       frames;
+    std::vector<SwitchState> switches;
+
+    explicit TreeAnnotator(Script& script, const SymTable& symbols, ProgramContext& program) :
+        script(script), symbols(symbols), program(program), commands(program.commands)
+    {}
+
+    bool pre(SyntaxTree& node)
+    {
+        if(frames.empty())
+        {
+            this->ctx = Context();
+            return enter(node, walk(node));
+        }
+
+        Frame& parent = frames.back();
+        size_t child_id = parent.next_child++;
+        this->ctx = parent.context;
+
+        switch(parent.node->type())
+        {
+            case NodeType::IF:
+            case NodeType::WHILE:
+            {
+                if(child_id == 0) // the condition list
+                {
+                    ctx.is_condition_block = true;
+
+                    if(node.type() == NodeType::AND || node.type() == NodeType::OR)
+                    {
+                        if(node.child_count() > 8)
+                            program.error(node, "use of more than 8 conditions is not supported");
+                    }
+                }
+                else if(parent.node->type() == NodeType::WHILE)
+                {
+                    ++ctx.loop_depth_break;
+                    ++ctx.loop_depth_continue;
+                }
+                break;
+            }
+
+            case NodeType::REPEAT:
+            {
+                // the counter and variable are annotated together with the REPEAT
+                if(child_id < 2)
+                    return false;
+
+                ++ctx.loop_depth_break;
+                ++ctx.loop_depth_continue;
+                break;
+            }
+
+            case NodeType::SWITCH:
+            {
+                // the variable is annotated together with the SWITCH
+                if(child_id == 0)
+                    return false;
+
+                // the childs of the body are handled by `walk_switch_body`
+                ++ctx.loop_depth_break;
+                return enter(node, true);
+            }
+
+            default:
+            {
+                if(frames.size() >= 2 && frames[frames.size() - 2].node->type() == NodeType::SWITCH)
+                    return enter(node, walk_switch_body(node));
+                break;
+            }
+        }
+
+        return enter(node, walk(node));
+    }
+
+    void post(SyntaxTree& node)
+    {
+        this->ctx = std::move(frames.back().context);
+        frames.pop_back();
+
+        if(node.type() == NodeType::REPEAT)
+            leave_repeat(node);
+        else if(node.type() == NodeType::SWITCH)
+            leave_switch(node);
+    }
+
+    /// Pushes a frame for `node` if its childs are going to be visited.
+    bool enter(SyntaxTree& node, bool visit_childs)
+    {
+        if(visit_childs)
+            frames.push_back(Frame { &node, 0, ctx });
+        return visit_childs;
+    }
+
+    auto directive_info(NodeType type)
     {
         switch(type)
         {
@@ -701,14 +877,14 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
             default:
                 Unreachable();
         }
-    };
+    }
 
-    auto alternator_for_expr = [&](const SyntaxTree& op) -> optional<const Commands::Alternator&>
+    auto alternator_for_expr(const SyntaxTree& op) -> optional<const Commands::Alternator&>
     {
         switch(op.type())
         {
             case NodeType::Equal:
-                if(is_condition_block)
+                if(ctx.is_condition_block)
                     return commands.is_thing_equal_to_thing;
                 else
                     return commands.set;
@@ -739,42 +915,12 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
             default:
                 return nullopt;
         }
-    };
-
-    auto traverse_condition_list = [&](SyntaxTree& node)
-    {
-        auto guard = make_scope_guard([&, was_cond_before = is_condition_block] {
-            is_condition_block = was_cond_before;
-        });
-
-        is_condition_block = true;
-
-        if(node.type() == NodeType::AND || node.type() == NodeType::OR)
-        {
-            if(node.child_count() > 8)
-                program.error(node, "use of more than 8 conditions is not supported");
-
-            node.depth_first(std::ref(walker));
-        }
-        else
-        {
-            walker(node);
-        }
-    };
-
-    auto traverse_loop_body = [&](SyntaxTree& node, bool allow_break, bool allow_continue)
-    {
-        auto guard = make_scope_guard([&, prev_break = loop_depth_break, prev_cont = loop_depth_continue] {
-            loop_depth_break = prev_break;
-            loop_depth_continue = prev_cont;
-        });
-
-        loop_depth_break += allow_break? 1 : 0;
-        loop_depth_continue += allow_continue? 1 : 0;
-        node.depth_first(std::ref(walker));
-    };
+    }
 
-    walker = [&](SyntaxTree& node)
+    /// Annotates `node` in the current context.
+    ///
+    /// Returns whether the childs of the node should be visited.
+    bool walk(SyntaxTree& node)
     {
         ++num_statements;
         switch(node.type())
@@ -793,36 +939,15 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
             case NodeType::Scope:
             {
                 // already annotated in SymTable::scan_symbols, but let's inform about current scope.
-
-                assert(current_scope == nullptr);
-
-                auto guard = make_scope_guard([&] {
-                    current_scope = nullptr;
-                });
-
-                current_scope = node.annotation<shared_ptr<Scope>>();
-                node.child(0).depth_first(std::ref(walker));
-                return false;
+                assert(ctx.current_scope == nullptr);
+                ctx.current_scope = node.annotation<shared_ptr<Scope>>();
+                return true;
             }
 
             case NodeType::IF:
-            {
-                traverse_condition_list(node.child(0));
-                node.child(1).depth_first(std::ref(walker));
-                if(node.child_count() == 3)
-                {
-                    assert(node.child(2).type() == NodeType::ELSE);
-                    node.child(2).depth_first(std::ref(walker));
-                }
-                return false;
-            }
-
             case NodeType::WHILE:
-            {
-                traverse_condition_list(node.child(0));
-                traverse_loop_body(node.child(1), true, true);
-                return false;
-            }
+                // the context of the condition list and of the bodies is set up in `pre`
+                return true;
 
             case NodeType::MISSION_START:
             case NodeType::SCRIPT_START:
@@ -856,7 +981,7 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                     if(*had_start == false)
                         program.error(node, "{} without a {}", dir_end, dir_start);
 
-                    if(this->is_child_of(ScriptType::CustomScript))
+                    if(script.is_child_of(ScriptType::CustomScript))
                     {
                         const Command& command = program.supported_or_fatal(node, commands.terminate_this_custom_script, "TERMINATE_THIS_CUSTOM_SCRIPT");
                         node.set_annotation(std::cref(command));
@@ -876,17 +1001,16 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
 
             case NodeType::NOT:
             {
-                if(!is_condition_block && !program.opt.relax_not)
+                if(!ctx.is_condition_block && !program.opt.relax_not)
                     program.error(node, "NOT outside of a conditional statement [-frelax-not]");
 
-                node.child(0).depth_first(std::ref(walker));
-                return false;
+                return true;
             }
 
             case NodeType::Command:
             {
                 auto command_name = node.child(0).text();
-                auto use_filenames = (this->type == ScriptType::Main || this->type == ScriptType::MainExtension);
+                auto use_filenames = (script.type == ScriptType::Main || script.type == ScriptType::MainExtension);
 
                 if(use_filenames && iequal_to()(command_name, "LOAD_AND_LAUNCH_MISSION"))
                 {
@@ -928,7 +1052,7 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                 }
                 else
                 {
-                    auto exp_command = commands.match(node, symbols, current_scope, program.opt);
+                    auto exp_command = commands.match(node, symbols, ctx.current_scope, program.opt);
                     if(exp_command)
                     {
                         const Command& command = **exp_command;
@@ -942,7 +1066,7 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                         if(command.extension && program.opt.pedantic)
                             program.pedantic(node, "this command is a language extension [-pedantic]");
 
-                        commands.annotate(node, command, symbols, current_scope, *this, program);
+                        commands.annotate(node, command, symbols, ctx.current_scope, script, program);
                         node.set_annotation(std::cref(command));
 
                         if(commands.equal(command, commands.skip_cutscene_start))
@@ -959,7 +1083,7 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                             }
                             else
                             {
-                                cutscene_skip = std::make_shared<Label>(current_scope, this->shared_from_this());
+                                cutscene_skip = std::make_shared<Label>(ctx.current_scope, script.shared_from_this());
                                 node.set_annotation(ReplacedCommandAnnotation { internal, {cutscene_skip} } );
                             }
                         }
@@ -972,7 +1096,7 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                         }
                         else if(commands.equal(command, commands.cleo_return))
                         {
-                            if(!current_scope)
+                            if(!ctx.current_scope)
                                 program.error(node, "CLEO_RETURN must be inside a scope");
                         }
                     }
@@ -992,7 +1116,7 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                 auto& times = node.child(0);
                 auto& var = node.child(1);
 
-                auto exp_command = commands.match(repeat, node, { &times, &var }, symbols, current_scope, program.opt);
+                auto exp_command = commands.match(repeat, node, { &times, &var }, symbols, ctx.current_scope, program.opt);
                 if(!exp_command)
                 {
                     exp_command.error().emit(program);
@@ -1000,50 +1124,8 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                 }
 
                 assert(*exp_command == &repeat);
-                commands.annotate({ &times, &var }, **exp_command, symbols, current_scope, *this, program);
-
-                traverse_loop_body(node.child(2), true, true);
-
-                auto number_zero = Commands::MatchArgument(0);
-                auto number_one = Commands::MatchArgument(1);
-
-                auto& alt_set = program.supported_or_fatal(node, commands.set, "SET");
-                auto& alt_add_thing_to_thing = program.supported_or_fatal(node, commands.add_thing_to_thing, "ADD_THING_TO_THING");
-                auto& alt_is_thing_greater_or_equal_to_thing = program.supported_or_fatal(node, commands.is_thing_greater_or_equal_to_thing,
-                                                                                          "IS_THING_GREATER_OR_EQUAL_TO_THING");
-
-                auto exp_set_var_to_zero = commands.match(alt_set, node, { &var, number_zero }, symbols, current_scope, program.opt);
-                auto exp_add_var_with_one = commands.match(alt_add_thing_to_thing, node, { &var, number_one }, symbols, current_scope, program.opt);
-                auto exp_is_var_geq_times = commands.match(alt_is_thing_greater_or_equal_to_thing, node, { &var, &times }, symbols, current_scope, program.opt);
-
-                if(exp_set_var_to_zero && exp_add_var_with_one && exp_is_var_geq_times)
-                {
-                    commands.annotate({ &var, nullopt }, **exp_set_var_to_zero, symbols, current_scope, *this, program);
-                    commands.annotate({ &var, nullopt }, **exp_add_var_with_one, symbols, current_scope, *this, program);
-                    commands.annotate({ &var, &times }, **exp_is_var_geq_times, symbols, current_scope, *this, program);
-
-                    node.set_annotation(RepeatAnnotation {
-                        **exp_set_var_to_zero, **exp_add_var_with_one, **exp_is_var_geq_times,
-                        std::move(number_zero), std::move(number_one)
-                    });
-
-                    if(program.opt.pedantic)
-                    {
-                        if(auto varinfo = get_base_var_annotation(var))
-                        {
-                            if((*varinfo)->global == false)
-                                program.pedantic(var, "REPEAT only allows global variables [-pedantic]");
-                        }
-                    }
-                }
-                else
-                {
-                    if(!exp_set_var_to_zero)  exp_set_var_to_zero.error().emit(program);
-                    if(!exp_add_var_with_one) exp_add_var_with_one.error().emit(program);
-                    if(!exp_is_var_geq_times) exp_is_var_geq_times.error().emit(program);
-                }
-
-                return false;
+                commands.annotate({ &times, &var }, **exp_command, symbols, ctx.current_scope, script, program);
+                return true;
             }
 
             case NodeType::SWITCH:
@@ -1051,129 +1133,19 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                 if(!program.opt.fswitch)
                     program.error(node, "SWITCH not supported [-fswitch]");
 
-                std::vector<int32_t> case_values;
-                bool had_default = false;
-                bool last_statement_was_break = true;
-
-                shared_ptr<const SyntaxTree> last_case;
                 auto& var = node.child(0);
 
                 const Command& switch_command = program.supported_or_fatal(node, commands.switch_, "SWITCH");
                 const Command& case_command   = program.supported_or_fatal(node, commands.case_, "CASE");
 
-                auto exp_switch = commands.match(switch_command, node, { &var }, symbols, current_scope, program.opt);
+                auto exp_switch = commands.match(switch_command, node, { &var }, symbols, ctx.current_scope, program.opt);
                 if(exp_switch)
-                    commands.annotate({ &var }, **exp_switch, symbols, current_scope, *this, program);
+                    commands.annotate({ &var }, **exp_switch, symbols, ctx.current_scope, script, program);
                 else
                     exp_switch.error().emit(program);
 
-                auto guard = [&, prev_break = loop_depth_break] {
-                    loop_depth_break = prev_break;
-                };
-
-                ++loop_depth_break;
-
-                for(auto& body_node : node.child(1))
-                {
-                    switch(body_node->type())
-                    {
-                        case NodeType::CASE:
-                        {
-                            if(last_case && !last_statement_was_break)
-                                program.error(*last_case, "CASE does not end with a BREAK");
-
-                            auto& case_node = body_node;
-                            last_case       = body_node;
-
-                            auto& case_value = case_node->child(0);
-
-                            auto exp_case = commands.match(case_command, *case_node, { &case_value }, symbols, current_scope, program.opt);
-                            if(exp_case)
-                            {
-                                commands.annotate({ &case_value }, **exp_case, symbols, current_scope, *this, program);
-                                case_node->set_annotation(SwitchCaseAnnotation{ nullptr });
-                            }
-                            else
-                            {
-                                exp_case.error().emit(program);
-                            }
-
-                            if(!commands.switch_start)
-                            {
-                                auto& alt_is_thing_equal_to_thing = program.supported_or_fatal(node, commands.is_thing_equal_to_thing,
-                                                                                                "IS_THING_EQUAL_TO_THING");
-                                auto exp_is_var_eq_int  = commands.match(alt_is_thing_equal_to_thing, *case_node, { &var, &case_value },
-                                                                         symbols, current_scope, program.opt);
-                                if(exp_is_var_eq_int)
-                                {
-                                    commands.annotate({ &var, &case_value }, **exp_is_var_eq_int, symbols, current_scope, *this, program);
-                                    case_node->set_annotation(SwitchCaseAnnotation{ *exp_is_var_eq_int });
-                                }
-                                else if(exp_case) // if CASE matching didn't fail but alternator did
-                                {
-                                    exp_is_var_eq_int.error().emit(program);
-                                }
-                            }
-
-                            if(case_value.is_annotated())
-                            {
-                                if(auto v = case_value.maybe_annotation<const int32_t&>())
-                                {
-                                    if(std::find(case_values.begin(), case_values.end(), *v) != case_values.end())
-                                        program.error(*case_node, "duplicate CASE value {}", *v);
-                                    else
-                                        case_values.emplace_back(*v);
-                                }
-                            }
-
-                            break;
-                        }
-
-                        case NodeType::DEFAULT:
-                        {
-                            if(had_default)
-                                program.error(*body_node, "multiple DEFAULT labels in one SWITCH");
-
-                            if(last_case && !last_statement_was_break)
-                                program.error(*last_case, "CASE does not end with a BREAK");
-
-                            last_case = body_node;
-                            had_default = true;
-                            break;
-                        }
-
-                        case NodeType::BREAK:
-                            if(last_case)
-                                last_statement_was_break = true;
-                            else
-                                program.error(*body_node, "BREAK not within a CASE or DEFAULT label");
-                            break;
-
-                        default: // statement
-                            if(last_case)
-                            {
-                                last_statement_was_break = false;
-                                body_node->depth_first(std::ref(walker));
-                            }
-                            else
-                            {
-                                program.error(*body_node, "statement not within a CASE or DEFAULT label");
-                            }
-                            break;
-                    }
-                }
-
-                if(last_case && !last_statement_was_break)
-                    program.error(*last_case, "CASE does not end with a BREAK");
-
-                if(auto switch_case_limit = program.opt.switch_case_limit)
-                {
-                    if(case_values.size() > static_cast<size_t>(*switch_case_limit))
-                        program.error(node, "SWITCH contains more than {} cases [-fswitch-case-limit]", *switch_case_limit);
-                }
-
-                node.set_annotation(SwitchAnnotation { case_values.size(), had_default });
-                return false;
+                switches.push_back(SwitchState { &node, &case_command });
+                return true;
             }
 
             case NodeType::Equal:
@@ -1194,16 +1166,16 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                     auto& b = op.child(0);
                     auto& c = op.child(1);
 
-                    auto exp_cmd_set = commands.match(alter_cmds1, node, { &a, &b }, symbols, current_scope, program.opt);
-                    auto exp_cmd_op  = commands.match(*alter_op, node, { &a, &c }, symbols, current_scope, program.opt);
+                    auto exp_cmd_set = commands.match(alter_cmds1, node, { &a, &b }, symbols, ctx.current_scope, program.opt);
+                    auto exp_cmd_op  = commands.match(*alter_op, node, { &a, &c }, symbols, ctx.current_scope, program.opt);
 
-                    if(is_condition_block)
+                    if(ctx.is_condition_block)
                         program.error(node, "expression not allowed in this context");
 
                     if(exp_cmd_set && exp_cmd_op)
                     {
-                        commands.annotate({ &a, &b }, **exp_cmd_set, symbols, current_scope, *this, program);
-                        commands.annotate({ &a, &c }, **exp_cmd_op, symbols, current_scope, *this, program);
+                        commands.annotate({ &a, &b }, **exp_cmd_set, symbols, ctx.current_scope, script, program);
+                        commands.annotate({ &a, &c }, **exp_cmd_op, symbols, ctx.current_scope, script, program);
 
                         const char* message = nullptr;
                         switch(op.type())
@@ -1234,13 +1206,13 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                                     program.error(node, message);
                             }
 
-                            auto exp_cmd_set2 = commands.match(alter_cmds1, node, { &a, &c }, symbols, current_scope, program.opt);
-                            auto exp_cmd_op2  = commands.match(*alter_op, node, { &a, &b }, symbols, current_scope, program.opt);
+                            auto exp_cmd_set2 = commands.match(alter_cmds1, node, { &a, &c }, symbols, ctx.current_scope, program.opt);
+                            auto exp_cmd_op2  = commands.match(*alter_op, node, { &a, &b }, symbols, ctx.current_scope, program.opt);
 
                             if(exp_cmd_set2 && exp_cmd_op2)
                             {
-                                commands.annotate({ &a, &c }, **exp_cmd_set2, symbols, current_scope, *this, program);
-                                commands.annotate({ &a, &b }, **exp_cmd_op2, symbols, current_scope, *this, program);
+                                commands.annotate({ &a, &c }, **exp_cmd_set2, symbols, ctx.current_scope, script, program);
+                                commands.annotate({ &a, &b }, **exp_cmd_op2, symbols, ctx.current_scope, script, program);
 
                                 node.set_annotation(std::cref(**exp_cmd_set2));
                                 op.set_annotation(std::cref(**exp_cmd_op2));
@@ -1272,13 +1244,13 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                     auto& a = node.child(!invert? 0 : 1);
                     auto& b = node.child(!invert? 1 : 0);
 
-                    if(is_condition_block && node.type() == NodeType::Cast)
+                    if(ctx.is_condition_block && node.type() == NodeType::Cast)
                         program.error(node, "expression not allowed in this context");
 
-                    auto exp_command = commands.match(alter_cmds1, node, { &a, &b }, symbols, current_scope, program.opt);
+                    auto exp_command = commands.match(alter_cmds1, node, { &a, &b }, symbols, ctx.current_scope, program.opt);
                     if(exp_command)
                     {
-                        commands.annotate({ &a, &b }, **exp_command, symbols, current_scope, *this, program);
+                        commands.annotate({ &a, &b }, **exp_command, symbols, ctx.current_scope, script, program);
                         node.set_annotation(std::cref(**exp_command));
                     }
                     else
@@ -1297,13 +1269,13 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
 
                 auto& var_ident = node.child(0);
                 
-                if(is_condition_block)
+                if(ctx.is_condition_block)
                     program.error(node, "expression not allowed in this context");
 
-                auto exp_op_var_with_one = commands.match(alternator_thing, node, { &var_ident, 1 }, symbols, current_scope, program.opt);
+                auto exp_op_var_with_one = commands.match(alternator_thing, node, { &var_ident, 1 }, symbols, ctx.current_scope, program.opt);
                 if(exp_op_var_with_one)
                 {
-                    commands.annotate({ &var_ident, nullopt }, **exp_op_var_with_one, symbols, current_scope, *this, program);
+                    commands.annotate({ &var_ident, nullopt }, **exp_op_var_with_one, symbols, ctx.current_scope, script, program);
                     node.set_annotation(IncDecAnnotation { **exp_op_var_with_one, 1 });
                 }
                 else
@@ -1318,7 +1290,7 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
             {
                 if(!program.opt.allow_break_continue)
                     program.error(node, "BREAK only allowed at the end of a SWITCH CASE [-fbreak-continue]");
-                else if(!loop_depth_break)
+                else if(!ctx.loop_depth_break)
                     program.error(node, "BREAK not in a loop or SWITCH statement");
                 else
                     program.pedantic(node, "BREAK anywhere is a language extension [-pedantic]");
@@ -1331,7 +1303,7 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
 
                 if(!program.opt.allow_break_continue)
                     program.error(node, "CONTINUE is not supported [-fbreak-continue]");
-                else if(!loop_depth_continue)
+                else if(!ctx.loop_depth_continue)
                     program.error(node, "CONTINUE not in a loop");
                 return false;
             }
@@ -1348,9 +1320,190 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                 --num_statements;
                 return true;
         }
-    };
+    }
+
+    /// Annotates a child of the body of a SWITCH, which is either a statement or a CASE, DEFAULT or BREAK.
+    bool walk_switch_body(SyntaxTree& body_node)
+    {
+        SwitchState& sw = switches.back();
+        auto& var = sw.node->child(0);
+
+        switch(body_node.type())
+        {
+            case NodeType::CASE:
+            {
+                if(sw.last_case && !sw.last_statement_was_break)
+                    program.error(*sw.last_case, "CASE does not end with a BREAK");
+
+                sw.last_case = body_node.shared_from_this();
+
+                auto& case_value = body_node.child(0);
+
+                auto exp_case = commands.match(*sw.case_command, body_node, { &case_value }, symbols, ctx.current_scope, program.opt);
+                if(exp_case)
+                {
+                    commands.annotate({ &case_value }, **exp_case, symbols, ctx.current_scope, script, program);
+                    body_node.set_annotation(SwitchCaseAnnotation{ nullptr, nullptr });
+                }
+                else
+                {
+                    exp_case.error().emit(program);
+                }
+
+                if(!commands.switch_start)
+                {
+                    auto& alt_is_thing_equal_to_thing = program.supported_or_fatal(*sw.node, commands.is_thing_equal_to_thing,
+                                                                                    "IS_THING_EQUAL_TO_THING");
+                    auto exp_is_var_eq_int  = commands.match(alt_is_thing_equal_to_thing, body_node, { &var, &case_value },
+                                                             symbols, ctx.current_scope, program.opt);
+                    if(exp_is_var_eq_int)
+                    {
+                        commands.annotate({ &var, &case_value }, **exp_is_var_eq_int, symbols, ctx.current_scope, script, program);
+
+                        // Allows a binary search on the cases, if available. See CompilerContext::compile_switch.
+                        const Command* is_var_gt_int = nullptr;
+                        if(program.opt.optimize_switch && commands.is_thing_greater_than_thing)
+                        {
+                            auto exp_is_var_gt_int = commands.match(*commands.is_thing_greater_than_thing, body_node, { &var, &case_value },
+                                                                    symbols, ctx.current_scope, program.opt);
+                            if(exp_is_var_gt_int && (*exp_is_var_gt_int)->supported)
+                            {
+                                commands.annotate({ &var, &case_value }, **exp_is_var_gt_int, symbols, ctx.current_scope, script, program);
+                                is_var_gt_int = *exp_is_var_gt_int;
+                            }
+                        }
+
+                        body_node.set_annotation(SwitchCaseAnnotation{ *exp_is_var_eq_int, is_var_gt_int });
+                    }
+                    else if(exp_case) // if CASE matching didn't fail but alternator did
+                    {
+                        exp_is_var_eq_int.error().emit(program);
+                    }
+                }
+
+                if(case_value.is_annotated())
+                {
+                    if(auto v = case_value.maybe_annotation<const int32_t&>())
+                    {
+                        if(std::find(sw.case_values.begin(), sw.case_values.end(), *v) != sw.case_values.end())
+                            program.error(body_node, "duplicate CASE value {}", *v);
+                        else
+                            sw.case_values.emplace_back(*v);
+                    }
+                }
+
+                return false;
+            }
+
+            case NodeType::DEFAULT:
+            {
+                if(sw.had_default)
+                    program.error(body_node, "multiple DEFAULT labels in one SWITCH");
+
+                if(sw.last_case && !sw.last_statement_was_break)
+                    program.error(*sw.last_case, "CASE does not end with a BREAK");
+
+                sw.last_case = body_node.shared_from_this();
+                sw.had_default = true;
+                return false;
+            }
+
+            case NodeType::BREAK:
+                if(sw.last_case)
+                    sw.last_statement_was_break = true;
+                else
+                    program.error(body_node, "BREAK not within a CASE or DEFAULT label");
+                return false;
+
+            default: // statement
+                if(sw.last_case)
+                {
+                    sw.last_statement_was_break = false;
+                    return walk(body_node);
+                }
+                else
+                {
+                    program.error(body_node, "statement not within a CASE or DEFAULT label");
+                    return false;
+                }
+        }
+    }
+
+    /// Annotates the counting of a REPEAT after its body.
+    void leave_repeat(SyntaxTree& node)
+    {
+        auto& times = node.child(0);
+        auto& var = node.child(1);
+
+        auto number_zero = Commands::MatchArgument(0);
+        auto number_one = Commands::MatchArgument(1);
+
+        auto& alt_set = program.supported_or_fatal(node, commands.set, "SET");
+        auto& alt_add_thing_to_thing = program.supported_or_fatal(node, commands.add_thing_to_thing, "ADD_THING_TO_THING");
+        auto& alt_is_thing_greater_or_equal_to_thing = program.supported_or_fatal(node, commands.is_thing_greater_or_equal_to_thing,
+                                                                                  "IS_THING_GREATER_OR_EQUAL_TO_THING");
+
+        auto exp_set_var_to_zero = commands.match(alt_set, node, { &var, number_zero }, symbols, ctx.current_scope, program.opt);
+        auto exp_add_var_with_one = commands.match(alt_add_thing_to_thing, node, { &var, number_one }, symbols, ctx.current_scope, program.opt);
+        auto exp_is_var_geq_times = commands.match(alt_is_thing_greater_or_equal_to_thing, node, { &var, &times }, symbols, ctx.current_scope, program.opt);
+
+        if(exp_set_var_to_zero && exp_add_var_with_one && exp_is_var_geq_times)
+        {
+            commands.annotate({ &var, nullopt }, **exp_set_var_to_zero, symbols, ctx.current_scope, script, program);
+            commands.annotate({ &var, nullopt }, **exp_add_var_with_one, symbols, ctx.current_scope, script, program);
+            commands.annotate({ &var, &times }, **exp_is_var_geq_times, symbols, ctx.current_scope, script, program);
+
+            node.set_annotation(RepeatAnnotation {
+                **exp_set_var_to_zero, **exp_add_var_with_one, **exp_is_var_geq_times,
+                std::move(number_zero), std::move(number_one)
+            });
+
+            if(program.opt.pedantic)
+            {
+                if(auto varinfo = get_base_var_annotation(var))
+                {
+                    if((*varinfo)->global == false)
+                        program.pedantic(var, "REPEAT only allows global variables [-pedantic]");
+                }
+            }
+        }
+        else
+        {
+            if(!exp_set_var_to_zero)  exp_set_var_to_zero.error().emit(program);
+            if(!exp_add_var_with_one) exp_add_var_with_one.error().emit(program);
+            if(!exp_is_var_geq_times) exp_is_var_geq_times.error().emit(program);
+        }
+    }
+
+    /// Checks the cases of a SWITCH after its body.
+    void leave_switch(SyntaxTree& node)
+    {
+        SwitchState& sw = switches.back();
+
+        if(sw.last_case && !sw.last_statement_was_break)
+            program.error(*sw.last_case, "CASE does not end with a BREAK");
+
+        if(auto switch_case_limit = program.opt.switch_case_limit)
+        {
+            if(sw.case_values.size() > static_cast<size_t>(*switch_case_limit))
+                program.error(node, "SWITCH contains more than {} cases [-fswitch-case-limit]", *switch_case_limit);
+        }
+
+        node.set_annotation(SwitchAnnotation { sw.case_values.size(), sw.had_default });
+        switches.pop_back();
+    }
+};
+}
+
+void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
+{
+    TreeAnnotator annotator(*this, symbols, program);
+    this->tree->visit(annotator);
 
-    this->tree->depth_first(std::ref(walker));
+    const bool had_mission_start = annotator.had_mission_start;
+    const bool had_mission_end   = annotator.had_mission_end;
+    const bool had_script_start  = annotator.had_script_start;
+    const bool had_script_end    = annotator.had_script_end;
 
     if(this->type == ScriptType::Mission || this->type == ScriptType::CustomMission || this->type == ScriptType::Subscript)
     {
@@ -1373,7 +1526,7 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                       to_string(this->type));
     }
 
-    if(cutscene_skip)
+    if(annotator.cutscene_skip)
     {
         program.error(*this, "missing SKIP_CUTSCENE_END");
     }
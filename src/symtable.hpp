@@ -15,6 +15,12 @@ struct UserConstant
 class IncluderTable
 {
 public:
+    IncluderTable() = default;
+    IncluderTable(const IncluderTable&) = delete;
+    IncluderTable(IncluderTable&&) = default;
+    IncluderTable& operator=(const IncluderTable&) = delete;
+    IncluderTable& operator=(IncluderTable&&) = default;
+
     /// Construts a IncluderTable from the lines in `script`.
     static IncluderTable from_script(const Script& script, ProgramContext& program);
 
@@ -33,6 +39,18 @@ protected:
     friend class Script;
     bool add_script(ScriptType type, const SyntaxTree& command, ProgramContext& program);
 
+    /// Records in `types_index` that `filename` was seen as a script of the specified `type`.
+    void index_script(ScriptType type, const string_view& filename);
+
+    /// Gets the mask of `type_bit`s of `filename` in `types_index`, adding it if not there yet.
+    uint8_t& type_mask(const string_view& filename);
+
+    /// Bit of `type` in the `types_index` masks.
+    static uint8_t type_bit(ScriptType type)
+    {
+        return uint8_t(1u << static_cast<unsigned>(type));
+    }
+
 public:
     //!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!//
     // IMPORTANT! Make sure whenever you add any new field to this object, to update merge() accordingly !!!!!!!!//
@@ -43,6 +61,13 @@ public:
     std::vector<std::string>    mission;    //< LOAD_AND_LAUNCH_MISSION scripts
     std::vector<std::string>    streamed;   //< Streamed scripts
     std::vector<std::string>    streamed_names;//< Constant names associated with streamed scripts.
+
+protected:
+    /// Mask of `type_bit`s for each filename in the script vectors above, kept in sync with them.
+    insensitive_unordered_map<string_view, uint8_t> types_index;
+
+    /// Storage for the filenames viewed by the keys of `types_index`.
+    std::deque<std::string> types_names;
 };
 
 /// Stores important symbols defined throught scripts (labels, vars, scopes).
@@ -143,6 +168,12 @@ public:
     IncluderTable ictable;
 
     uint32_t offset_global_vars = 0;
+
+protected:
+    shared_ptr<Var> highest_global; //< Cache for `highest_global_var()`.
+
+    /// Updates `highest_global` after the global variable `var` was added into this table.
+    void track_global_var(const shared_ptr<Var>& var);
 };
 
 inline auto get_base_var_annotation(const SyntaxTree& var_node) -> optional<shared_ptr<Var>>
@@ -8,6 +8,7 @@
 #elif defined(__unix__)
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #endif
 
 static fs::path find_config_path()
@@ -78,6 +79,33 @@ const fs::path& config_path()
     return conf_path;
 }
 
+optional<string_view> find_builtin_config(const string_view& config_name, const string_view& filename)
+{
+    auto find_file = [](const string_view& config_name, const string_view& filename) -> optional<string_view>
+    {
+        for(auto file = GTA3SC_BUILTIN_CONFIG_FILES; file->data != nullptr; ++file)
+        {
+            if(iequal_to()(config_name, file->config_name) && filename == file->filename)
+                return string_view(file->data, file->size);
+        }
+        return nullopt;
+    };
+
+    if(auto opt_data = find_file(config_name, filename))
+        return opt_data;
+    return find_file("", filename);
+}
+
+bool has_builtin_config(const string_view& config_name)
+{
+    for(auto file = GTA3SC_BUILTIN_CONFIG_FILES; file->data != nullptr; ++file)
+    {
+        if(!config_name.empty() && iequal_to()(config_name, file->config_name))
+            return true;
+    }
+    return false;
+}
+
 bool allocate_file(FILE* f, uint64_t size)
 {
 #if defined(_WIN32)
@@ -102,3 +130,39 @@ bool allocate_file(FILE* f, uint64_t size)
 #   error allocate_file not implemented for this platform.
 #endif
 }
+
+void* map_file(FILE* f, uint64_t size)
+{
+    if(size == 0 || fflush(f) != 0)
+        return nullptr;
+
+#if defined(_WIN32)
+    HANDLE hFile = (HANDLE) _get_osfhandle(_fileno(f));
+
+    HANDLE hMapping = CreateFileMappingW(hFile, NULL, PAGE_READWRITE, DWORD(size >> 32), DWORD(size & 0xFFFFFFFF), NULL);
+    if(hMapping == NULL)
+        return nullptr;
+
+    // The view keeps a reference to the mapping object.
+    void* data = MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(size));
+    CloseHandle(hMapping);
+    return data;
+
+#elif defined(__unix__)
+    void* data = mmap(nullptr, static_cast<size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED, fileno(f), 0);
+    return (data != MAP_FAILED? data : nullptr);
+#else
+#   error map_file not implemented for this platform.
+#endif
+}
+
+bool unmap_file(void* data, uint64_t size)
+{
+#if defined(_WIN32)
+    return !!UnmapViewOfFile(data);
+#elif defined(__unix__)
+    return !munmap(data, static_cast<size_t>(size));
+#else
+#   error unmap_file not implemented for this platform.
+#endif
+}
@@ -7,7 +7,36 @@
 /// Returns the path that static configuration is in.
 extern const fs::path& config_path();
 
+/// A static configuration file built into the executable (see GTA3SC_BUILTIN_CONFIG in CMakeLists.txt).
+struct BuiltinConfigFile
+{
+    const char* config_name;    //< Configuration directory (e.g. gtasa) or empty for files at the root of `config_path()`.
+    const char* filename;       //< Name of the file in the configuration directory.
+    const char* data;
+    size_t      size;
+};
+
+/// All the configuration files built into the executable, terminated by a null entry.
+extern const BuiltinConfigFile GTA3SC_BUILTIN_CONFIG_FILES[];
+
+/// Finds a configuration file built into the executable.
+///
+/// When not found in the `config_name` directory, also looks up files from the root of the static configuration.
+extern optional<string_view> find_builtin_config(const string_view& config_name, const string_view& filename);
+
+/// Checks whether the configuration `config_name` was built into the executable.
+extern bool has_builtin_config(const string_view& config_name);
+
 /// Allocates size for a file.
 /// \warning the behaviour is undefined if the file isn't empty.
 /// \note the file offset after this call is at the top of the file.
 extern bool allocate_file(FILE*, uint64_t);
+
+/// Maps the first `size` bytes of a file into memory, for reading and writing.
+///
+/// The file must have been opened for both reading and writing, and be at least `size` bytes long (see `allocate_file`).
+/// \returns the mapped memory, or `nullptr` on failure (e.g. the file is not a regular file).
+extern void* map_file(FILE*, uint64_t size);
+
+/// Unmaps memory previously mapped by `map_file`. Changes are carried into the file.
+extern bool unmap_file(void* data, uint64_t size);
@@ -0,0 +1,26 @@
+// RUN: %gta3sc %s --config=gta3 --low-memory -emit-ir2 -o - | %FileCheck %s
+// RUN: %dis %gta3sc %s --config=gta3 --low-memory -mno-header -mlocal-offsets -o /dev/null 2>&1 | %verify %s
+
+VAR_INT x
+
+// CHECK-NEXT-L: MAIN_1:
+main_loop:
+// CHECK-NEXT-L: WAIT 0i8
+WAIT 0
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 0i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_2
+IF x = 0
+    // CHECK-NEXT-L: GOSUB @MAIN_3
+    GOSUB sub
+ENDIF
+// CHECK-NEXT-L: MAIN_2:
+// CHECK-NEXT-L: GOTO @MAIN_1
+GOTO main_loop // expected-error {{label at the zero offset}}
+
+// CHECK-NEXT-L: MAIN_3:
+sub:
+// CHECK-NEXT-L: SET_VAR_INT &8 1i8
+x = 1
+// CHECK-NEXT-L: RETURN
+RETURN
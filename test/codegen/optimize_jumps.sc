@@ -0,0 +1,56 @@
+// RUN: %gta3sc %s --config=gtavc -moptimize-jumps -emit-ir2 -o - | %FileCheck %s
+
+VAR_INT x
+
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 0i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_1
+IF x = 0
+    // CHECK-NEXT-L: WAIT 1i8
+    // CHECK-NEXT-L: GOTO @MAIN_3
+    WAIT 1
+ELSE
+    // CHECK-NEXT-L: MAIN_1:
+    // CHECK-NEXT-L: ANDOR 0i8
+    // CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 1i8
+    // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_2
+    IF x = 1
+        // CHECK-NEXT-L: WAIT 2i8
+        // CHECK-NEXT-L: GOTO @MAIN_3
+        WAIT 2
+    ELSE
+        // CHECK-NEXT-L: MAIN_2:
+        // CHECK-NEXT-L: WAIT 3i8
+        WAIT 3
+    ENDIF
+ENDIF
+
+// CHECK-NEXT-L: MAIN_3:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 0i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_4
+WHILE x = 0
+    // CHECK-NEXT-L: WAIT 4i8
+    // CHECK-NEXT-L: GOTO @MAIN_3
+    WAIT 4
+    GOTO skip
+    WAIT 5
+    skip:
+ENDWHILE
+
+// CHECK-NEXT-L: MAIN_4:
+// CHECK-NEXT-L: GOSUB @MAIN_5
+GOTO next
+next:
+GOSUB sub
+
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+TERMINATE_THIS_SCRIPT
+WAIT 6
+
+// CHECK-NEXT-L: MAIN_5:
+// CHECK-NEXT-L: GOTO @MAIN_5
+sub:
+GOTO sub
+// CHECK-NOT-L: RETURN
+RETURN
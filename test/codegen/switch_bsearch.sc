@@ -0,0 +1,201 @@
+// RUN: %gta3sc %s --config=gta3 -fswitch --guesser -moptimize-switch -emit-ir2 -o - | %FileCheck %s
+// RUN: %gta3sc %s --config=gtavc -fswitch --guesser -moptimize-switch -emit-ir2 -o - | %FileCheck %s
+VAR_INT n
+
+// Large enough to be searched, with contiguous cases coalesced into ranges.
+{
+    SWITCH n
+        // CHECK-NEXT-L: NOT IS_INT_VAR_GREATER_THAN_NUMBER &8 29i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_1
+        // CHECK-NEXT-L: ANDOR 21i8
+        // CHECK-NEXT-L: IS_INT_VAR_GREATER_THAN_NUMBER &8 3i8
+        // CHECK-NEXT-L: NOT IS_INT_VAR_GREATER_THAN_NUMBER &8 0i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_2
+        // CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 10i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_3
+        // CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 20i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_4
+        // CHECK-NEXT-L: GOTO @MAIN_8
+        // CHECK-NEXT-L: MAIN_1:
+        // CHECK-NEXT-L: IS_INT_VAR_GREATER_THAN_NUMBER &8 31i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_5
+        // CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 40i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_6
+        // CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 50i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_7
+        // CHECK-NEXT-L: GOTO @MAIN_8
+        CASE 2
+        CASE 1
+        CASE 3
+            // CHECK-NEXT-L: MAIN_2:
+            // CHECK-NEXT-L: WAIT 1i8
+            // CHECK-NEXT-L: GOTO @MAIN_9
+            WAIT 1
+            BREAK
+        CASE 10
+            // CHECK-NEXT-L: MAIN_3:
+            // CHECK-NEXT-L: WAIT 10i8
+            // CHECK-NEXT-L: GOTO @MAIN_9
+            WAIT 10
+            BREAK
+        CASE 20
+            // CHECK-NEXT-L: MAIN_4:
+            // CHECK-NEXT-L: WAIT 20i8
+            // CHECK-NEXT-L: GOTO @MAIN_9
+            WAIT 20
+            BREAK
+        CASE 30
+        CASE 31
+            // CHECK-NEXT-L: MAIN_5:
+            // CHECK-NEXT-L: WAIT 30i8
+            // CHECK-NEXT-L: GOTO @MAIN_9
+            WAIT 30
+            BREAK
+        CASE 40
+            // CHECK-NEXT-L: MAIN_6:
+            // CHECK-NEXT-L: WAIT 40i8
+            // CHECK-NEXT-L: GOTO @MAIN_9
+            WAIT 40
+            BREAK
+        CASE 50
+            // CHECK-NEXT-L: MAIN_7:
+            // CHECK-NEXT-L: WAIT 50i8
+            // CHECK-NEXT-L: GOTO @MAIN_9
+            WAIT 50
+            BREAK
+        DEFAULT
+            // CHECK-NEXT-L: MAIN_8:
+            // CHECK-NEXT-L: WAIT 0i8
+            // CHECK-NEXT-L: GOTO @MAIN_9
+            WAIT 0
+            BREAK
+    ENDSWITCH
+}
+
+// Cheaper as a chain of comparisons.
+{
+    // CHECK-NEXT-L: MAIN_9:
+    SWITCH n
+        // CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 1i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_10
+        CASE 1
+            // CHECK-NEXT-L: WAIT 1i8
+            // CHECK-NEXT-L: GOTO @MAIN_11
+            WAIT 1
+            BREAK
+        // CHECK-NEXT-L: MAIN_10:
+        // CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 2i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_11
+        CASE 2
+            // CHECK-NEXT-L: WAIT 2i8
+            // CHECK-NEXT-L: GOTO @MAIN_11
+            WAIT 2
+            BREAK
+    ENDSWITCH
+}
+
+// More than 8 cases with the same body, which cannot be compiled as a chain of comparisons.
+{
+    // CHECK-NEXT-L: MAIN_11:
+    SWITCH n
+        // CHECK-NEXT-L: NOT IS_INT_VAR_GREATER_THAN_NUMBER &8 8i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_13
+        // CHECK-NEXT-L: NOT IS_INT_VAR_GREATER_THAN_NUMBER &8 4i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_12
+        // CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 1i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_15
+        // CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 3i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_15
+        // CHECK-NEXT-L: GOTO @MAIN_16
+        // CHECK-NEXT-L: MAIN_12:
+        // CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 5i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_15
+        // CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 7i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_15
+        // CHECK-NEXT-L: GOTO @MAIN_16
+        // CHECK-NEXT-L: MAIN_13:
+        // CHECK-NEXT-L: NOT IS_INT_VAR_GREATER_THAN_NUMBER &8 12i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_14
+        // CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 9i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_15
+        // CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 11i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_15
+        // CHECK-NEXT-L: GOTO @MAIN_16
+        // CHECK-NEXT-L: MAIN_14:
+        // CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 13i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_15
+        // CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 15i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_15
+        // CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 17i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_15
+        // CHECK-NEXT-L: GOTO @MAIN_16
+        CASE 1
+        CASE 3
+        CASE 5
+        CASE 7
+        CASE 9
+        CASE 11
+        CASE 13
+        CASE 15
+        CASE 17
+            // CHECK-NEXT-L: MAIN_15:
+            // CHECK-NEXT-L: WAIT 1i8
+            // CHECK-NEXT-L: GOTO @MAIN_16
+            WAIT 1
+            BREAK
+    ENDSWITCH
+}
+
+// Negative values, and ranges reaching the limits of the integer type.
+{
+    // CHECK-NEXT-L: MAIN_16:
+    SWITCH n
+        // CHECK-NEXT-L: NOT IS_INT_VAR_GREATER_THAN_NUMBER &8 -1i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_17
+        // CHECK-NEXT-L: IS_INT_VAR_GREATER_THAN_NUMBER &8 -2147483647i32
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_18
+        // CHECK-NEXT-L: ANDOR 21i8
+        // CHECK-NEXT-L: IS_INT_VAR_GREATER_THAN_NUMBER &8 -3i8
+        // CHECK-NEXT-L: NOT IS_INT_VAR_GREATER_THAN_NUMBER &8 -6i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_19
+        // CHECK-NEXT-L: GOTO @MAIN_22
+        // CHECK-NEXT-L: MAIN_17:
+        // CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 0i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_20
+        // CHECK-NEXT-L: NOT IS_INT_VAR_GREATER_THAN_NUMBER &8 2147483645i32
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_21
+        // CHECK-NEXT-L: GOTO @MAIN_22
+        CASE -2147483648
+        CASE -2147483647
+            // CHECK-NEXT-L: MAIN_18:
+            // CHECK-NEXT-L: WAIT 1i8
+            // CHECK-NEXT-L: GOTO @MAIN_22
+            WAIT 1
+            BREAK
+        CASE -5
+        CASE -4
+        CASE -3
+            // CHECK-NEXT-L: MAIN_19:
+            // CHECK-NEXT-L: WAIT 2i8
+            // CHECK-NEXT-L: GOTO @MAIN_22
+            WAIT 2
+            BREAK
+        CASE 0
+            // CHECK-NEXT-L: MAIN_20:
+            // CHECK-NEXT-L: WAIT 3i8
+            // CHECK-NEXT-L: GOTO @MAIN_22
+            WAIT 3
+            BREAK
+        CASE 2147483646
+        CASE 2147483647
+            // CHECK-NEXT-L: MAIN_21:
+            // CHECK-NEXT-L: WAIT 4i8
+            // CHECK-NEXT-L: GOTO @MAIN_22
+            WAIT 4
+            BREAK
+    ENDSWITCH
+}
+
+// CHECK-NEXT-L: MAIN_22:
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+TERMINATE_THIS_SCRIPT
@@ -28,4 +28,6 @@ SWITCH x
 		BREAK
 ENDSWITCH
 
+BREAK     // expected-error {{BREAK not in a loop or SWITCH statement}}
+
 TERMINATE_THIS_SCRIPT
\ No newline at end of file
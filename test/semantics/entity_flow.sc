@@ -0,0 +1,25 @@
+// RUN: %dis %gta3sc %s --config=gtavc -fsyntax-only -fno-entity-tracking -Wentity-flow 2>&1 | %verify %s
+{
+LVAR_INT x car char
+
+CREATE_CAR 0 .0 .0 .0 car
+CREATE_CHAR 0 0 .0 .0 .0 char
+
+x = car
+EXPLODE_CAR x // fine
+
+IF IS_CHAR_DEAD char
+	x = char
+	EXPLODE_CAR x // expected-warning {{variable may be of type CHAR in this path, but CAR is expected}}
+ENDIF
+
+EXPLODE_CAR x // expected-warning {{variable may be of type CHAR in this path, but CAR is expected}}
+
+x = car
+EXPLODE_CAR x // fine, x is a CAR in all paths
+
+loop:
+EXPLODE_CAR x // expected-warning {{variable may be of type CHAR in this path, but CAR is expected}}
+x = char
+GOTO loop
+}
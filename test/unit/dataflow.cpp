@@ -0,0 +1,176 @@
+// Tests ForwardDataflow (see src/dataflow.hpp) on hand made graphs, since its incremental
+// re-solve is not reachable from the compiler driver.
+#include <stdinc.h>
+#include "dataflow.hpp"
+
+static int num_failures = 0;
+
+#define CHECK(cond) \
+    ((cond)? void(0) : (fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #cond), void(++num_failures)))
+
+/// Graph with the same interface as a ControlFlowGraph, whose block `i` begins at the instruction `i`.
+struct TestGraph
+{
+    std::vector<ControlFlowGraph::Block> blocks;
+
+    explicit TestGraph(size_t num_blocks, std::initializer_list<std::pair<uint32_t, uint32_t>> edges,
+                       std::initializer_list<uint32_t> entries)
+    {
+        for(size_t i = 0; i < num_blocks; ++i)
+            blocks.emplace_back(i, i + 1, false);
+
+        for(auto& edge : edges)
+        {
+            blocks[edge.first].succs.push_back(edge.second);
+            blocks[edge.second].preds.push_back(edge.first);
+        }
+
+        for(auto b : entries)
+            blocks[b].is_entry = true;
+    }
+
+    size_t size() const { return blocks.size(); }
+
+    const ControlFlowGraph::Block& block(size_t i) const { return blocks[i]; }
+};
+
+/// Facts which may hold in a block. Each block kills and generates some facts.
+struct FactsAnalysis
+{
+    using State = std::set<int>;
+
+    std::vector<std::set<int>>  gen;
+    std::vector<std::set<int>>  kill;
+    mutable std::vector<int>    num_transfers; //< How many times each block was transferred.
+
+    explicit FactsAnalysis(size_t num_blocks) :
+        gen(num_blocks), kill(num_blocks), num_transfers(num_blocks, 0)
+    {}
+
+    State entry_state() const
+    {
+        return State();
+    }
+
+    void join(State& into, const State& from) const
+    {
+        into.insert(from.begin(), from.end());
+    }
+
+    void transfer(const ControlFlowGraph::Block& block, State& state) const
+    {
+        ++num_transfers[block.begin];
+
+        for(auto fact : kill[block.begin])
+            state.erase(fact);
+
+        state.insert(gen[block.begin].begin(), gen[block.begin].end());
+    }
+
+    void reset_counters()
+    {
+        std::fill(num_transfers.begin(), num_transfers.end(), 0);
+    }
+};
+
+/// Checks whether `dataflow` has the same solution as a fresh solve of the same problem.
+template<typename Dataflow>
+static bool same_as_fresh_solve(const Dataflow& dataflow, const TestGraph& graph, const FactsAnalysis& analysis)
+{
+    FactsAnalysis fresh_analysis = analysis;
+    ForwardDataflow<FactsAnalysis, TestGraph> fresh(graph, fresh_analysis);
+    fresh.solve();
+
+    for(size_t b = 0; b < graph.size(); ++b)
+    {
+        if(dataflow.is_reachable(b) != fresh.is_reachable(b))
+            return false;
+        if(dataflow.is_reachable(b) && (dataflow.in_state(b) != fresh.in_state(b) || dataflow.out_state(b) != fresh.out_state(b)))
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    // Script A:
+    //
+    //   0 -> 1 -> 2 -> 3 -> 1 (loop)
+    //        1 -> 4
+    //   5 -> 6 (e.g. a subroutine entered from another script)
+    //   7 (unreachable)
+    //
+    TestGraph graph_a(8, { {0, 1}, {1, 2}, {2, 3}, {3, 1}, {1, 4}, {5, 6}, {7, 4} }, { 0, 5 });
+    FactsAnalysis analysis_a(graph_a.size());
+    analysis_a.gen[0] = { 1 };
+    analysis_a.gen[2] = { 2 };
+    analysis_a.gen[3] = { 3 };
+    analysis_a.kill[2] = { 1 };
+    analysis_a.gen[5] = { 5 };
+    analysis_a.gen[7] = { 7 };
+
+    // Script B:
+    //
+    //   0 -> 1
+    //
+    TestGraph graph_b(2, { {0, 1} }, { 0 });
+    FactsAnalysis analysis_b(graph_b.size());
+    analysis_b.gen[0] = { 10 };
+
+    ForwardDataflow<FactsAnalysis, TestGraph> dataflow_a(graph_a, analysis_a);
+    ForwardDataflow<FactsAnalysis, TestGraph> dataflow_b(graph_b, analysis_b);
+    dataflow_a.solve();
+    dataflow_b.solve();
+
+    CHECK(same_as_fresh_solve(dataflow_a, graph_a, analysis_a));
+    CHECK(same_as_fresh_solve(dataflow_b, graph_b, analysis_b));
+    CHECK(!dataflow_a.is_reachable(7));
+    CHECK((dataflow_a.in_state(1) == std::set<int> { 1, 2, 3 }));
+    CHECK((dataflow_a.out_state(4) == std::set<int> { 1, 2, 3 }));
+    CHECK((dataflow_a.out_state(6) == std::set<int> { 5 }));
+
+    // Block 3 of script A no longer generates its fact. Since that fact used to go around the
+    // loop, it must not survive the re-solve in any block of the loop.
+    analysis_a.reset_counters();
+    analysis_b.reset_counters();
+    analysis_a.gen[3] = { };
+    dataflow_a.resolve({ 3 });
+
+    CHECK(same_as_fresh_solve(dataflow_a, graph_a, analysis_a));
+    CHECK((dataflow_a.in_state(1) == std::set<int> { 1, 2 }));
+    CHECK((dataflow_a.out_state(4) == std::set<int> { 1, 2 }));
+
+    // Only the blocks reachable from block 3 were computed again.
+    CHECK(analysis_a.num_transfers[0] == 0);
+    CHECK(analysis_a.num_transfers[1] > 0);
+    CHECK(analysis_a.num_transfers[2] > 0);
+    CHECK(analysis_a.num_transfers[3] > 0);
+    CHECK(analysis_a.num_transfers[4] > 0);
+    CHECK(analysis_a.num_transfers[5] == 0);
+    CHECK(analysis_a.num_transfers[6] == 0);
+    CHECK(analysis_a.num_transfers[7] == 0);
+    CHECK(analysis_b.num_transfers[0] == 0 && analysis_b.num_transfers[1] == 0);
+
+    // A change in the subroutine of script A touches nothing else.
+    analysis_a.reset_counters();
+    analysis_a.gen[5] = { 5, 6 };
+    dataflow_a.resolve({ 5 });
+
+    CHECK(same_as_fresh_solve(dataflow_a, graph_a, analysis_a));
+    CHECK((dataflow_a.out_state(6) == std::set<int> { 5, 6 }));
+    CHECK(analysis_a.num_transfers[5] == 1);
+    CHECK(analysis_a.num_transfers[6] == 1);
+    CHECK(std::count(analysis_a.num_transfers.begin(), analysis_a.num_transfers.end(), 0) == 6);
+
+    // A change in a block which cannot be reached changes no state.
+    analysis_a.reset_counters();
+    analysis_a.gen[7] = { 8 };
+    dataflow_a.resolve({ 7 });
+
+    CHECK(same_as_fresh_solve(dataflow_a, graph_a, analysis_a));
+    CHECK(!dataflow_a.is_reachable(7));
+    CHECK(analysis_a.num_transfers[4] == 1);
+    CHECK(analysis_a.num_transfers[0] == 0 && analysis_a.num_transfers[1] == 0);
+
+    return num_failures == 0? EXIT_SUCCESS : EXIT_FAILURE;
+}